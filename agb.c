@@ -0,0 +1,118 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "agb.h"
+
+int agb_setup(void)
+{
+    agb_t* gb = (agb_t*)calloc(1, sizeof(agb_t));
+    int err = 0;
+
+    if (gb == NULL)
+        return -1;
+
+#ifdef _ALU_TABLES
+    /* cpu_reset() won't build them again */
+    if (alu_init(gb))
+        err = -1;
+#endif
+    cpu_reset(gb);
+    free(gb);
+
+#ifdef _SIMD
+    if (ppu_simd_init())
+        err = -1;
+#endif
+
+    return err;
+}
+
+agb_t* agb_init(char* name)
+{
+    agb_t* gb = (agb_t*)calloc(1, sizeof(agb_t));
+
+    if (gb == NULL)
+        return NULL;
+
+    gb->cpu.mmu = mmu_init(name);
+    if (gb->cpu.mmu == NULL) {
+        free(gb);
+        return NULL;
+    }
+
+    gb->ppu.render = RENDER_FULL;
+    cpu_reset(gb);
+    ppu_reset(gb);
+
+    return gb;
+}
+
+void agb_reset(agb_t* gb)
+{
+    /* The worker keeps drawing the old lines from the VRAM they had;
+       mmu_reset() marks everything changed for the ones after */
+    if (gb->ppu.pipe)
+        render_split(gb->ppu.pipe);
+
+    mmu_reset(gb->cpu.mmu);
+    cpu_reset(gb);
+    ppu_reset(gb);
+}
+
+void agb_render(agb_t* gb, uint8_t every)
+{
+    gb->ppu.render = every;
+}
+
+int agb_pipeline(agb_t* gb, int on)
+{
+    if (on && gb->ppu.pipe == NULL) {
+        gb->ppu.pipe = render_open();
+        if (gb->ppu.pipe == NULL)
+            return -1;
+    } else if (!on && gb->ppu.pipe) {
+        render_close(gb->ppu.pipe);
+        gb->ppu.pipe = NULL;
+
+        /* The worker took the VRAM changes, decode everything again */
+        memset(gb->cpu.mmu->tile_dirty, 0xFF, sizeof(gb->cpu.mmu->tile_dirty));
+    }
+
+    return 0;
+}
+
+void agb_free(agb_t* gb)
+{
+    if (gb->ppu.pipe)
+        render_close(gb->ppu.pipe);
+#ifdef _JIT
+    jit_free(&gb->jit);
+#endif
+    mmu_free(gb->cpu.mmu);
+    free(gb);
+}
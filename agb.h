@@ -0,0 +1,84 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef _AGB_H
+#define _AGB_H
+
+#include "cpu.h"
+#include "mmu.h"
+#include "event.h"
+#include "ppu.h"
+#include "render.h"
+
+#ifdef _JIT
+#include "jit.h"
+#endif
+
+/* One emulated Game Boy. Everything the CPU core changes while running
+   lives in here, so any number of them can run side by side. */
+struct agb {
+    cpu_t cpu;              /* CPU, and the memory it owns through cpu.mmu */
+    sched_t sched;          /* Pending events */
+    ppu_t ppu;              /* LCD */
+
+    uint8_t curr_save_slot; /* Save states */
+    cpu_t save_states[10];
+
+#ifdef _DECODE_CACHE
+    dblock_t dcache[DCACHE_SIZE]; /* Decoded blocks */
+#endif
+#ifdef _JIT
+    jit_t jit;              /* Native code for dcache */
+#endif
+};
+
+/* Build the tables all emulators share. agb_init() does this the first
+   time; call it before creating emulators from several threads. Returns
+   -1 on failure. */
+int agb_setup(void);
+
+/* Create an emulator and load a ROM into it, NULL on failure */
+agb_t* agb_init(char* name);
+
+/* Power-cycle an emulator, keeping its ROM, memory and battery RAM */
+void agb_reset(agb_t* gb);
+
+/* Draw one frame in every (RENDER_FULL for all of them), or none with
+   RENDER_OFF. The LCD keeps its timing and interrupts either way, only
+   the pixels are skipped; fb holds the last frame drawn. Takes effect
+   at the next frame. */
+void agb_render(agb_t* gb, uint8_t every);
+
+/* Draw on a worker thread (on) or in line (off), returns -1 if the
+   worker can't be started. With the worker on, frames come out of
+   render_frame(gb->ppu.pipe) instead of gb->ppu.fb, from the next whole
+   frame on. */
+int agb_pipeline(agb_t* gb, int on);
+
+/* Free an emulator and its memory */
+void agb_free(agb_t* gb);
+
+#endif
@@ -0,0 +1,422 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+/*
+ * Batch runner. Runs every session in a manifest to its frame budget,
+ * spread over one worker thread per core. Each worker owns a deque of
+ * sessions and takes from its back; idle workers steal from the front of
+ * the others'. Sessions pinned to a core only ever run on the worker
+ * bound to it.
+ *
+ * Build with -D_BATCH together with cpu.c, mmu.c, mbc.c, battery.c, rom.c,
+ * inflate.c, event.c, ppu.c, render.c, agb.c (and jit.c for _JIT), linking
+ * with -lpthread.
+ * Sessions of the same packed ROM share one unpacked copy.
+ *
+ * Manifest lines are "rom frames [core] [option...]", # starts a
+ * comment. The core must be below the number of workers. Options set up
+ * that session alone:
+ *
+ *     render=every   draw one frame in every, 0 for none
+ *
+ *     batch [-j workers] [-p] [-r every] [-w] [-s ms] manifest
+ *
+ * -p binds worker n to core n; pinned sessions imply it. -r is the render
+ * option for sessions that don't give one (the default draws every
+ * frame). Battery RAM starts from the .sav files but is not written back,
+ * so sessions don't see each other's saves; -w writes it back, from one
+ * session per file at a time, and -s sets how often it is flushed. The
+ * exit status is 1 if any session failed to start.
+ */
+
+#define _GNU_SOURCE /* pthread_setaffinity_np, clock_gettime */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "agb.h"
+
+#define FRAME_CLOCKS 70224 /* M clocks per frame */
+#define ROM_NAME_MAX 256
+
+typedef struct {
+    char rom[ROM_NAME_MAX];
+    uint32_t frames;   /* Budget */
+    int core;          /* Core to run on, -1 for any */
+    int render;        /* Render mode, -1 for the -r one */
+
+    uint32_t done;     /* Frames run */
+    uint64_t insns;    /* Instructions run */
+    double secs;       /* Wall time */
+    int worker;        /* Worker that ran it */
+    uint8_t failed;    /* Could not start */
+} job_t;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    uint32_t* deque;   /* Job indices, front is stolen from */
+    uint32_t front, back;
+    uint32_t* pinned;  /* Jobs only this worker may run */
+    uint32_t npinned;
+    int core;          /* Core it is bound to, -1 if none */
+    int id;
+    uint8_t started;   /* Has a thread of its own */
+} worker_t;
+
+job_t* jobs;
+uint32_t njobs;
+worker_t* workers;
+int nworkers;
+uint8_t render = RENDER_FULL;
+
+double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Parse a whole decimal argument in [min, max], min >= 0, returns -1
+   if it isn't one */
+long parse_arg(const char* s, long min, long max)
+{
+    char* end;
+    long v = strtol(s, &end, 10);
+
+    if (*end != '\0' || end == s || v < min || v > max)
+        return -1;
+    return v;
+}
+
+/* Set j up from one token after the frame budget, returns -1 if it
+   isn't a core number or a known option */
+int parse_option(job_t* j, const char* tok)
+{
+    char* end;
+    long v;
+
+    if (strncmp(tok, "render=", 7) == 0) {
+        v = strtol(tok + 7, &end, 10);
+        if (*end != '\0' || end == tok + 7 || v < 0 || v > 255)
+            return -1;
+        j->render = (int)v;
+        return 0;
+    }
+
+    /* A bare number is the core, once */
+    v = strtol(tok, &end, 10);
+    if (*end != '\0' || end == tok || v < 0 || j->core >= 0)
+        return -1;
+    j->core = (int)v;
+    return 0;
+}
+
+/* Read the manifest, returns -1 on failure */
+int load_manifest(const char* name)
+{
+    FILE* f = fopen(name, "r");
+    char line[ROM_NAME_MAX + 256];
+    const char* sep = " \t\r\n";
+    char* tok;
+    char* end;
+    unsigned long frames;
+    uint32_t cap = 0;
+    job_t job;
+    job_t* grown;
+
+    if (f == NULL) {
+        perror(name);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strchr(line, '#') != NULL)
+            *strchr(line, '#') = '\0';
+
+        tok = strtok(line, sep);
+        if (tok == NULL)
+            continue;
+
+        memset(&job, 0, sizeof(job_t));
+        job.core = -1;
+        job.render = -1;
+
+        if (strlen(tok) >= ROM_NAME_MAX) {
+            fprintf(stderr, "%s: ROM name too long: %s\n", name, tok);
+            fclose(f);
+            return -1;
+        }
+        strcpy(job.rom, tok);
+
+        tok = strtok(NULL, sep);
+        frames = tok ? strtoul(tok, &end, 10) : 0;
+        if (tok == NULL || *end != '\0') {
+            fprintf(stderr, "%s: missing frame budget for %s\n", name, job.rom);
+            fclose(f);
+            return -1;
+        }
+        job.frames = (uint32_t)frames;
+
+        while ((tok = strtok(NULL, sep)) != NULL) {
+            if (parse_option(&job, tok) < 0) {
+                fprintf(stderr, "%s: %s: bad option %s\n", name, job.rom, tok);
+                fclose(f);
+                return -1;
+            }
+        }
+
+        if (njobs == cap) {
+            cap = cap ? cap * 2 : 64;
+            grown = (job_t*)realloc(jobs, cap * sizeof(job_t));
+            if (grown == NULL) {
+                fclose(f);
+                return -1;
+            }
+            jobs = grown;
+        }
+
+        jobs[njobs++] = job;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/* Take the next job for w, stealing if its own are done. Returns -1 once
+   there is nothing left anywhere. */
+long next_job(worker_t* w)
+{
+    worker_t* v;
+    long job = -1;
+    int i;
+
+    if (w->npinned > 0)
+        return w->pinned[--w->npinned];
+
+    pthread_mutex_lock(&w->lock);
+    if (w->back > w->front)
+        job = w->deque[--w->back];
+    pthread_mutex_unlock(&w->lock);
+
+    for (i = 1; job < 0 && i < nworkers; i++) {
+        v = &workers[(w->id + i) % nworkers];
+
+        pthread_mutex_lock(&v->lock);
+        if (v->back > v->front)
+            job = v->deque[v->front++];
+        pthread_mutex_unlock(&v->lock);
+    }
+
+    return job;
+}
+
+void run_job(worker_t* w, job_t* j)
+{
+    agb_t* gb = agb_init(j->rom);
+    uint32_t start;
+    double t0 = now();
+
+    j->worker = w->id;
+
+    if (gb == NULL) {
+        fprintf(stderr, "%s: could not start\n", j->rom);
+        j->failed = 1;
+        return;
+    }
+    agb_render(gb, j->render >= 0 ? (uint8_t)j->render : render);
+
+    if (battery_persist && gb->cpu.mmu->battery && !gb->cpu.mmu->battery->shared)
+        fprintf(stderr, "%s: save file in use, this session's is not kept\n", j->rom);
+
+    for (j->done = 0; j->done < j->frames; j->done++) {
+        start = gb->cpu.ins_count;
+        cpu_run(gb, FRAME_CLOCKS);
+        j->insns += (uint32_t)(gb->cpu.ins_count - start);
+    }
+
+    j->secs = now() - t0;
+    agb_free(gb);
+}
+
+void* worker_main(void* arg)
+{
+    worker_t* w = (worker_t*)arg;
+    long job;
+
+#ifdef __linux__
+    cpu_set_t set;
+
+    if (w->core >= 0) {
+        CPU_ZERO(&set);
+        CPU_SET(w->core, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+
+    while ((job = next_job(w)) >= 0)
+        run_job(w, &jobs[job]);
+
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int pin = 0;
+    int i, opt;
+    long v = 0;
+    uint32_t j, frames = 0, failed = 0;
+    uint64_t insns = 0;
+    worker_t* w;
+    double t0, secs;
+
+    nworkers = cores > 0 ? cores : 1;
+    battery_persist = 0;
+
+    while ((opt = getopt(argc, argv, "j:pr:ws:")) != -1) {
+        switch (opt) {
+        case 'j':
+            v = parse_arg(optarg, 1, 1024);
+            nworkers = (int)v;
+            break;
+        case 'p':
+            pin = 1;
+            break;
+        case 'r':
+            v = parse_arg(optarg, 0, 255);
+            render = (uint8_t)v;
+            break;
+        case 'w':
+            battery_persist = 1;
+            break;
+        case 's':
+            v = parse_arg(optarg, 0, 0x7FFFFFFF);
+            battery_flush_ms = (uint32_t)v;
+            break;
+        default:
+            v = -1;
+            break;
+        }
+
+        if (v < 0) {
+            fprintf(stderr, "usage: %s [-j workers] [-p] [-r every] [-w] [-s ms] manifest\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc || nworkers < 1) {
+        fprintf(stderr, "usage: %s [-j workers] [-p] [-r every] [-w] [-s ms] manifest\n", argv[0]);
+        return 1;
+    }
+
+    if (load_manifest(argv[optind]) < 0)
+        return 1;
+
+    /* A kernel that fails its self-check is a bug, don't time around it */
+    if (agb_setup() < 0) {
+        fprintf(stderr, "%s: setup failed\n", argv[0]);
+        return 1;
+    }
+
+    for (j = 0; j < njobs; j++) {
+        if (jobs[j].core >= nworkers) {
+            fprintf(stderr, "%s: core %d, but only %d workers\n", jobs[j].rom, jobs[j].core, nworkers);
+            return 1;
+        }
+        if (jobs[j].core >= 0)
+            pin = 1;
+    }
+
+    workers = (worker_t*)calloc(nworkers, sizeof(worker_t));
+    if (workers == NULL)
+        return 1;
+
+    for (i = 0; i < nworkers; i++) {
+        w = &workers[i];
+        w->id = i;
+        w->core = pin ? i % (cores > 0 ? cores : 1) : -1;
+        w->deque = (uint32_t*)malloc((njobs + 1) * sizeof(uint32_t));
+        w->pinned = (uint32_t*)malloc((njobs + 1) * sizeof(uint32_t));
+        if (w->deque == NULL || w->pinned == NULL)
+            return 1;
+        pthread_mutex_init(&w->lock, NULL);
+    }
+
+    /* Pinned jobs go to the worker on their core, the rest round-robin.
+       Deques are filled back to front so jobs start in manifest order. */
+    for (j = njobs, i = 0; j-- > 0;) {
+        if (jobs[j].core >= 0) {
+            w = &workers[jobs[j].core];
+            w->pinned[w->npinned++] = j;
+        } else {
+            w = &workers[i++ % nworkers];
+            w->deque[w->back++] = j;
+        }
+    }
+
+    t0 = now();
+    for (i = 0; i < nworkers; i++)
+        workers[i].started = pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) == 0;
+
+    /* Whatever couldn't get a thread runs here, its pinned jobs included */
+    for (i = 0; i < nworkers; i++) {
+        if (!workers[i].started) {
+            fprintf(stderr, "%s: no thread for worker %d, running it on the main thread\n", argv[0], i);
+            worker_main(&workers[i]);
+        }
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].started)
+            pthread_join(workers[i].thread, NULL);
+    }
+    secs = now() - t0;
+
+    for (j = 0; j < njobs; j++) {
+        if (jobs[j].failed) {
+            printf("%s: failed to start\n", jobs[j].rom);
+            failed++;
+            continue;
+        }
+        printf("%s: %lu frames in %.3f s on worker %d, %.1f frames/s\n",
+            jobs[j].rom, (unsigned long)jobs[j].done, jobs[j].secs, jobs[j].worker,
+            jobs[j].secs > 0 ? jobs[j].done / jobs[j].secs : 0.0);
+        frames += jobs[j].done;
+        insns += jobs[j].insns;
+    }
+
+    printf("%lu sessions, %lu frames in %.3f s on %d workers: %.1f frames/s, %.2f guest MIPS\n",
+        (unsigned long)njobs, (unsigned long)frames, secs, nworkers,
+        secs > 0 ? frames / secs : 0.0, secs > 0 ? insns / secs / 1e6 : 0.0);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L /* ftruncate, clock_gettime */
+#define _DEFAULT_SOURCE         /* flock, MAP_ANONYMOUS */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "battery.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+uint32_t battery_flush_ms = 1000;
+uint8_t battery_persist = 1;
+
+/* Save file name, the ROM name with its extension swapped for .sav */
+char* battery_path(const char* rom_name)
+{
+    const char* slash = strrchr(rom_name, '/');
+    const char* dot = strrchr(rom_name, '.');
+    size_t len = strlen(rom_name);
+    char* path;
+
+    if (dot && (slash == NULL || dot > slash))
+        len = (size_t)(dot - rom_name);
+
+    path = (char*)malloc(len + 5);
+    if (path == NULL)
+        return NULL;
+
+    memcpy(path, rom_name, len);
+    strcpy(path + len, ".sav");
+
+    return path;
+}
+
+/* Take the dirty chunks and write them out */
+void battery_flush(battery_t* b)
+{
+    uint32_t dirty;
+    uint32_t i;
+
+#ifdef __GNUC__
+    dirty = __atomic_exchange_n(&b->dirty, 0, __ATOMIC_ACQUIRE);
+#else
+    pthread_mutex_lock(&b->lock);
+    dirty = b->dirty;
+    b->dirty = 0;
+    pthread_mutex_unlock(&b->lock);
+#endif
+
+    for (i = 0; dirty; i++, dirty >>= 1) {
+        if (dirty & 1)
+            msync(b->data + i * b->chunk, b->chunk, MS_SYNC);
+    }
+}
+
+void* battery_main(void* arg)
+{
+    battery_t* b = (battery_t*)arg;
+    struct timespec until;
+
+    pthread_mutex_lock(&b->lock);
+
+    while (!b->stop) {
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += battery_flush_ms / 1000;
+        until.tv_nsec += (long)(battery_flush_ms % 1000) * 1000000;
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+
+        pthread_cond_timedwait(&b->wake, &b->lock, &until);
+
+        pthread_mutex_unlock(&b->lock);
+        battery_flush(b);
+        pthread_mutex_lock(&b->lock);
+    }
+
+    pthread_mutex_unlock(&b->lock);
+
+    return NULL;
+}
+
+/* Private copy of what fd holds, zero past its end. fd may be -1. */
+void* battery_copy(int fd, uint32_t size)
+{
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    uint32_t got = 0;
+    ssize_t n;
+
+    if (data == MAP_FAILED || fd < 0)
+        return data;
+
+    while (got < size && (n = read(fd, (uint8_t*)data + got, size - got)) > 0)
+        got += (uint32_t)n;
+
+    return data;
+}
+
+battery_t* battery_open(const char* rom_name, uint32_t size)
+{
+    battery_t* b = (battery_t*)calloc(1, sizeof(battery_t));
+    char* path = battery_path(rom_name);
+    long page = sysconf(_SC_PAGESIZE);
+    struct stat st;
+    void* data = MAP_FAILED;
+
+    if (b == NULL || path == NULL) {
+        free(b);
+        free(path);
+        return NULL;
+    }
+
+    b->fd = battery_persist ? open(path, O_RDWR | O_CREAT, 0644) : open(path, O_RDONLY);
+    free(path);
+
+    if (battery_persist && b->fd < 0) {
+        free(b);
+        return NULL;
+    }
+
+    if (battery_persist && flock(b->fd, LOCK_EX | LOCK_NB) == 0) {
+        /* A new or short file is zero-filled up to size */
+        if (fstat(b->fd, &st) == 0 &&
+                (st.st_size >= (off_t)size || ftruncate(b->fd, (off_t)size) == 0))
+            data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, b->fd, 0);
+        b->shared = 1;
+    } else {
+        /* Someone else writes the file, or nobody may */
+        data = battery_copy(b->fd, size);
+        if (b->fd >= 0)
+            close(b->fd);
+        b->fd = -1;
+    }
+
+    if (data == MAP_FAILED) {
+        if (b->fd >= 0)
+            close(b->fd);
+        free(b);
+        return NULL;
+    }
+
+    b->data = (uint8_t*)data;
+    b->size = size;
+
+    /* Fit the dirty chunks in 32 bits */
+    b->chunk = page > 0 ? (uint32_t)page : 4096;
+    while (size / b->chunk > 32)
+        b->chunk *= 2;
+
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->wake, NULL);
+    if (b->shared)
+        b->running = pthread_create(&b->thread, NULL, battery_main, b) == 0;
+
+    return b;
+}
+
+void battery_close(battery_t* b)
+{
+    if (b->running) {
+        pthread_mutex_lock(&b->lock);
+        b->stop = 1;
+        pthread_cond_signal(&b->wake);
+        pthread_mutex_unlock(&b->lock);
+        pthread_join(b->thread, NULL);
+    }
+
+    if (b->shared)
+        msync(b->data, b->size, MS_SYNC);
+    munmap(b->data, b->size);
+    if (b->fd >= 0)
+        close(b->fd);
+
+    pthread_mutex_destroy(&b->lock);
+    pthread_cond_destroy(&b->wake);
+    free(b);
+}
+
+void battery_dirty(battery_t* b, uint32_t offset)
+{
+    uint32_t bit = (uint32_t)1 << (offset / b->chunk);
+
+    if (!b->shared)
+        return;
+
+#ifdef __GNUC__
+    __atomic_fetch_or(&b->dirty, bit, __ATOMIC_RELEASE);
+#else
+    pthread_mutex_lock(&b->lock);
+    b->dirty |= bit;
+    pthread_mutex_unlock(&b->lock);
+#endif
+}
@@ -0,0 +1,77 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef _BATTERY_H
+#define _BATTERY_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/*
+ * Battery-backed cartridge RAM, mapped shared from the .sav file next to
+ * the ROM. The page cache holds every write as soon as it is made, so a
+ * killed process loses nothing; a background thread msyncs the chunks
+ * written since its last pass every battery_flush_ms, and once more on
+ * close, to get them onto the disk.
+ *
+ * Only one battery at a time writes a save file, it holds an exclusive
+ * flock() on it. Any other opened meanwhile, in this process or another,
+ * gets a private copy of the file that is dropped on close, as do all of
+ * them while battery_persist is off.
+ */
+typedef struct {
+    uint8_t* data;        /* Mapped save file, or its private copy */
+    uint32_t size;
+    uint32_t chunk;       /* Bytes per dirty bit, a multiple of the page size */
+    uint32_t dirty;       /* Chunks written since the last flush */
+    uint8_t shared;       /* data is the file, writes reach it */
+    int fd;               /* Locked save file, -1 for a private copy */
+    uint8_t stop;         /* Tell the flusher to quit */
+    uint8_t running;      /* Flusher started */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} battery_t;
+
+/* Milliseconds between background flushes, for batteries opened after */
+extern uint32_t battery_flush_ms;
+
+/* Write battery RAM back to the save files (the default), for batteries
+   opened after */
+extern uint8_t battery_persist;
+
+/* Map size bytes of the save file for ROM rom_name, returns NULL on
+   failure. A save file that is missing or short reads as zeros. */
+battery_t* battery_open(const char* rom_name, uint32_t size);
+
+/* Flush everything, stop the flusher and unmap */
+void battery_close(battery_t* b);
+
+/* Note a write to the byte at offset */
+void battery_dirty(battery_t* b, uint32_t offset);
+
+#endif
+
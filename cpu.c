@@ -24,44 +24,202 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 */
 
-#include "cpu.h"
+#include <stdio.h>
+#include "agb.h"
 
-/* Global CPU structure */
-cpu_t cpu;
+#ifdef _JIT
+#include <stddef.h>
+#include "jit.h"
+#endif
 
-/* Save states */
-uint8_t curr_save_slot;
-cpu_t save_states[10];
+#ifdef _JIT_VERIFY
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#ifdef _LAZY_FLAGS
+/*
+ * Lazy flags. The hot ALU helpers only record what they did in cpu.lf, and
+ * Z/N/H/C are worked out from that record when something actually looks at
+ * them. Anything else that touches the flags must SYNC_FLAGS() first.
+ */
+enum {
+    LF_NONE,  /* cpu.z/n/h/c are current */
+    LF_ADD,   /* ADD/ADC: a + b + c */
+    LF_SUB,   /* SUB/SBC/CP: a - b - c */
+    LF_INC,   /* INC: c is the carry it kept */
+    LF_DEC,   /* DEC: c is the carry it kept */
+    LF_AND,   /* AND */
+    LF_OR,    /* OR/XOR/SWAP */
+    LF_SHIFT, /* Rotates and shifts: c is the bit shifted out */
+    LF_ROTA   /* RLCA/RLA/RRCA/RRA: as above, but Z is always clear */
+};
+
+#define LAZY_FLAGS(op_, a_, b_, r_, c_) \
+    gb->cpu.lf.op = (op_);              \
+    gb->cpu.lf.a = (a_);                \
+    gb->cpu.lf.b = (b_);                \
+    gb->cpu.lf.r = (r_);                \
+    gb->cpu.lf.c = (c_)
+
+uint8_t lazy_z(agb_t* gb)
+{
+    switch (gb->cpu.lf.op) {
+    case LF_NONE:
+        return FLAG_Z;
+    case LF_ROTA:
+        return 0;
+    default:
+        return (gb->cpu.lf.r == 0);
+    }
+}
+
+uint8_t lazy_c(agb_t* gb)
+{
+    switch (gb->cpu.lf.op) {
+    case LF_NONE:
+        return FLAG_C;
+    case LF_ADD:
+        return (gb->cpu.lf.a + gb->cpu.lf.b + gb->cpu.lf.c > 0xFF);
+    case LF_SUB:
+        return (gb->cpu.lf.a < gb->cpu.lf.b + gb->cpu.lf.c);
+    case LF_AND:
+    case LF_OR:
+        return 0;
+    default:
+        return gb->cpu.lf.c;
+    }
+}
+
+/* Materialize all four flags from the last recorded operation */
+void flags_sync(agb_t* gb)
+{
+    uint8_t a = gb->cpu.lf.a;
+    uint8_t b = gb->cpu.lf.b;
+    uint8_t c = gb->cpu.lf.c;
+
+    switch (gb->cpu.lf.op) {
+    case LF_NONE:
+        return;
+    case LF_ADD:
+        FLAG_N = 0;
+        FLAG_H = ((a & 0x0F) + (b & 0x0F) + c > 0x0F);
+        FLAG_C = (a + b + c > 0xFF);
+        break;
+    case LF_SUB:
+        FLAG_N = 1;
+        FLAG_H = ((a & 0x0F) < (b & 0x0F) + c);
+        FLAG_C = (a < b + c);
+        break;
+    case LF_INC:
+        FLAG_N = 0;
+        FLAG_H = ((gb->cpu.lf.r & 0x0F) == 0);
+        FLAG_C = c;
+        break;
+    case LF_DEC:
+        FLAG_N = 1;
+        FLAG_H = ((gb->cpu.lf.r & 0x0F) == 0x0F);
+        FLAG_C = c;
+        break;
+    case LF_AND:
+        FLAG_N = 0;
+        FLAG_H = 1;
+        FLAG_C = 0;
+        break;
+    case LF_OR:
+        FLAG_N = 0;
+        FLAG_H = 0;
+        FLAG_C = 0;
+        break;
+    default:
+        FLAG_N = 0;
+        FLAG_H = 0;
+        FLAG_C = c;
+        break;
+    }
+
+    FLAG_Z = (gb->cpu.lf.op != LF_ROTA && gb->cpu.lf.r == 0);
+    gb->cpu.lf.op = LF_NONE;
+}
+
+#define SYNC_FLAGS() flags_sync(gb)
+#define GET_Z() lazy_z(gb)
+#define GET_C() lazy_c(gb)
+/* Only valid straight after rlc/rl/rrc/rr */
+#define CLEAR_Z() gb->cpu.lf.op = LF_ROTA
+#else
+#define SYNC_FLAGS()
+#define GET_Z() FLAG_Z
+#define GET_C() FLAG_C
+#define CLEAR_Z() FLAG_Z = 0
+#endif
+
+/* Pack the flags into an F register value */
+uint8_t get_f(agb_t* gb)
+{
+    SYNC_FLAGS();
+    return (FLAG_Z << 7) | (FLAG_N << 6) | (FLAG_H << 5) | (FLAG_C << 4);
+}
+
+/* Unpack an F register value into the flags */
+void set_f(agb_t* gb, uint8_t f)
+{
+    FLAG_Z = (f >> 7) & 1;
+    FLAG_N = (f >> 6) & 1;
+    FLAG_H = (f >> 5) & 1;
+    FLAG_C = (f >> 4) & 1;
+#ifdef _LAZY_FLAGS
+    gb->cpu.lf.op = LF_NONE;
+#endif
+}
+
+/* Immediate operands */
+#ifdef _DECODE_CACHE
+#define IMM_8() (REG_PC++, (uint8_t)gb->cpu.imm)
+#define IMM_16() (REG_PC += 2, gb->cpu.imm)
+#else
+#define IMM_8() read_8(gb->cpu.mmu, REG_PC++)
+#define IMM_16() (REG_PC += 2, read_16(gb->cpu.mmu, REG_PC - 2))
+#endif
+
+/* Make cpu_exec() return after this instruction, so cpu_run() gets to
+   look at interrupts. Anything that could make one pending does this. */
+#define END_SLICE() (gb->cpu.slice = 0)
 
 /* Helper functions */
-void push(uint16_t val)
+void push(agb_t* gb, uint16_t val)
 {
     REG_SP -= 2;
-    write_16(cpu.mmu, REG_SP, val);
+    write_16(gb->cpu.mmu, REG_SP, val);
 }
 
-uint16_t pop(void)
+uint16_t pop(agb_t* gb)
 {
     REG_SP += 2;
-    return read_16(cpu.mmu, REG_SP - 2);
+    return read_16(gb->cpu.mmu, REG_SP - 2);
 }
 
-uint8_t add_8_8(uint8_t a, uint8_t b)
+uint8_t add_8_8(agb_t* gb, uint8_t a, uint8_t b)
 {
     uint8_t ret = a + b;
 
+#ifdef _LAZY_FLAGS
+    LAZY_FLAGS(LF_ADD, a, b, ret, 0);
+#else
     FLAG_C = (0xFF - a < b);
     FLAG_H = (0x0F - (a & 0x0F) < (b & 0x0F));
     FLAG_Z = (ret == 0);
     FLAG_N = 0;
+#endif
 
     return ret;
 }
 
-uint16_t add_16_16(uint16_t a, uint16_t b)
+uint16_t add_16_16(agb_t* gb, uint16_t a, uint16_t b)
 {
     uint16_t ret = a + b;
 
+    SYNC_FLAGS();
     FLAG_C = (0xFFFF - a < b);
     FLAG_H = (0x0FFF - (a & 0x0FFF) < (b & 0x0FFF));
     FLAG_N = 0;
@@ -69,10 +227,11 @@ uint16_t add_16_16(uint16_t a, uint16_t b)
     return ret;
 }
 
-uint16_t add_16_8(uint16_t a, uint8_t b)
+uint16_t add_16_8(agb_t* gb, uint16_t a, uint8_t b)
 {
     uint16_t ret = a + (uint16_t)b;
 
+    SYNC_FLAGS();
     FLAG_C = (0xFF - (a & 0x00ff) < b);
     FLAG_H = (0x0F - (a & 0x0F) < (b & 0x0F));
     FLAG_Z = 0;
@@ -81,8 +240,16 @@ uint16_t add_16_8(uint16_t a, uint8_t b)
     return ret;
 }
 
-uint8_t adc(uint8_t a, uint8_t b)
+uint8_t adc(agb_t* gb, uint8_t a, uint8_t b)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = GET_C();
+    uint8_t ret = a + b + c;
+
+    LAZY_FLAGS(LF_ADD, a, b, ret, c);
+
+    return ret;
+#else
     uint8_t tmp, ret;
     uint8_t h = 0;
     uint8_t c = 0;
@@ -109,12 +276,18 @@ uint8_t adc(uint8_t a, uint8_t b)
     FLAG_N = 0;
 
     return ret;
+#endif
 }
 
-uint8_t sub(uint8_t a, uint8_t b)
+uint8_t sub(agb_t* gb, uint8_t a, uint8_t b)
 {
     uint8_t ret;
 
+#ifdef _LAZY_FLAGS
+    ret = a - b;
+
+    LAZY_FLAGS(LF_SUB, a, b, ret, 0);
+#else
     FLAG_C = (a < b);
     FLAG_H = ((a & 0x0F) < (b & 0x0F));
 
@@ -122,12 +295,21 @@ uint8_t sub(uint8_t a, uint8_t b)
 
     FLAG_Z = (ret == 0);
     FLAG_N = 1;
+#endif
 
     return ret;
 }
 
-uint8_t sbc(uint8_t a, uint8_t b)
+uint8_t sbc(agb_t* gb, uint8_t a, uint8_t b)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = GET_C();
+    uint8_t ret = a - b - c;
+
+    LAZY_FLAGS(LF_SUB, a, b, ret, c);
+
+    return ret;
+#else
     uint8_t tmp, ret;
     uint8_t h = 0;
     uint8_t c = 0;
@@ -148,15 +330,24 @@ uint8_t sbc(uint8_t a, uint8_t b)
     FLAG_N = 1;
 
     return ret;
+#endif
 }
 
-uint8_t inc_8(uint8_t a)
+uint8_t inc_8(agb_t* gb, uint8_t a)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = GET_C();
+
+    a++;
+
+    LAZY_FLAGS(LF_INC, 0, 0, a, c);
+#else
     a++;
 
     FLAG_H = ((a & 0x0F) == 0);
     FLAG_Z = (a == 0);
     FLAG_N = 0;
+#endif
 
     return a;
 }
@@ -166,13 +357,21 @@ uint16_t inc_16(uint16_t a)
     return a + 1;
 }
 
-uint8_t dec_8(uint8_t a)
+uint8_t dec_8(agb_t* gb, uint8_t a)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = GET_C();
+
+    a--;
+
+    LAZY_FLAGS(LF_DEC, 0, 0, a, c);
+#else
     a--;
 
     FLAG_H = ((a & 0x0F) == 0x0F);
     FLAG_Z = (a == 0);
     FLAG_N = 1;
+#endif
 
     return a;
 }
@@ -182,121 +381,179 @@ uint16_t dec_16(uint16_t a)
     return a - 1;
 }
 
-uint8_t and(uint8_t a, uint8_t b)
+uint8_t and(agb_t* gb, uint8_t a, uint8_t b)
 {
     uint8_t ret = a & b;
 
+#ifdef _LAZY_FLAGS
+    LAZY_FLAGS(LF_AND, 0, 0, ret, 0);
+#else
     FLAG_N = 0;
     FLAG_H = 1;
     FLAG_C = 0;
     FLAG_Z = (ret == 0);
+#endif
 
     return ret;
 }
 
-uint8_t or(uint8_t a, uint8_t b)
+uint8_t or(agb_t* gb, uint8_t a, uint8_t b)
 {
     uint8_t ret = a | b;
 
+#ifdef _LAZY_FLAGS
+    LAZY_FLAGS(LF_OR, 0, 0, ret, 0);
+#else
     FLAG_N = 0;
     FLAG_H = 0;
     FLAG_C = 0;
     FLAG_Z = (ret == 0);
+#endif
 
     return ret;
 }
 
-uint8_t xor(uint8_t a, uint8_t b)
+uint8_t xor(agb_t* gb, uint8_t a, uint8_t b)
 {
     uint8_t ret = a ^ b;
 
+#ifdef _LAZY_FLAGS
+    LAZY_FLAGS(LF_OR, 0, 0, ret, 0);
+#else
     FLAG_N = 0;
     FLAG_H = 0;
     FLAG_C = 0;
     FLAG_Z = (ret == 0);
+#endif
 
     return ret;
 }
 
-uint8_t swap(uint8_t a)
+uint8_t swap(agb_t* gb, uint8_t a)
 {
     uint8_t tmp = a & 0x0F;
 
     a >>= 4;
     a |= (tmp << 4);
 
+#ifdef _LAZY_FLAGS
+    LAZY_FLAGS(LF_OR, 0, 0, a, 0);
+#else
     FLAG_Z = (a == 0);
     FLAG_N = 0;
     FLAG_H = 0;
     FLAG_C = 0;
+#endif
 
     return a;
 }
 
-uint8_t rlc(uint8_t a)
+uint8_t rlc(agb_t* gb, uint8_t a)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = (a & 0x80) >> 7;
+    a = (a << 1) + c;
+
+    LAZY_FLAGS(LF_SHIFT, 0, 0, a, c);
+#else
     FLAG_C = (a & 0x80) >> 7;
     a = (a << 1) + FLAG_C;
 
     FLAG_Z = (a == 0);
     FLAG_N = 0;
     FLAG_H = 0;
+#endif
 
     return a;
 }
 
-uint8_t rl(uint8_t a)
+uint8_t rl(agb_t* gb, uint8_t a)
 {
-    uint8_t tmp = FLAG_C;
+    uint8_t tmp = GET_C();
+#ifdef _LAZY_FLAGS
+    uint8_t c = (a & 0x80) >> 7;
+    a = (a << 1) + tmp;
+
+    LAZY_FLAGS(LF_SHIFT, 0, 0, a, c);
+#else
     FLAG_C = (a & 0x80) >> 7;
     a = (a << 1) + tmp;
 
     FLAG_Z = (a == 0);
     FLAG_N = 0;
     FLAG_H = 0;
+#endif
 
     return a;
 }
 
-uint8_t rrc(uint8_t a)
+uint8_t rrc(agb_t* gb, uint8_t a)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = a & 0x01;
+    a = (a >> 1) + (c << 7);
+
+    LAZY_FLAGS(LF_SHIFT, 0, 0, a, c);
+#else
     FLAG_C = a & 0x01;
     a = (a >> 1) + (FLAG_C << 7);
 
     FLAG_Z = (a == 0);
     FLAG_N = 0;
-    FLAG_N = 0;
+    FLAG_H = 0;
+#endif
 
     return a;
 }
 
-uint8_t rr(uint8_t a)
+uint8_t rr(agb_t* gb, uint8_t a)
 {
-    uint8_t tmp = FLAG_C;
+    uint8_t tmp = GET_C();
+#ifdef _LAZY_FLAGS
+    uint8_t c = a & 0x01;
+    a = (a >> 1) + (tmp << 7);
+
+    LAZY_FLAGS(LF_SHIFT, 0, 0, a, c);
+#else
     FLAG_C = a & 0x01;
     a = (a >> 1) + (tmp << 7);
 
     FLAG_Z = (a == 0);
     FLAG_N = 0;
     FLAG_H = 0;
+#endif
 
     return a;
 }
 
-uint8_t sla(uint8_t a)
+uint8_t sla(agb_t* gb, uint8_t a)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = (a & 0x80) >> 7;
+    a <<= 1;
+
+    LAZY_FLAGS(LF_SHIFT, 0, 0, a, c);
+#else
     FLAG_C = (a & 0x80) >> 7;
     a <<= 1;
 
     FLAG_Z = (a == 0);
     FLAG_N = 0;
     FLAG_H = 0;
+#endif
 
     return a;
 }
 
-uint8_t sra(uint8_t a)
+uint8_t sra(agb_t* gb, uint8_t a)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = a & 0x01;
+    a >>= 1;
+    a |= ((a & 0x40) << 1);
+
+    LAZY_FLAGS(LF_SHIFT, 0, 0, a, c);
+#else
     FLAG_C = a & 0x01;
     a >>= 1;
     a |= ((a & 0x40) << 1);
@@ -304,24 +561,33 @@ uint8_t sra(uint8_t a)
     FLAG_Z = (a == 0);
     FLAG_N = 0;
     FLAG_H = 0;
+#endif
 
     return a;
 }
 
-uint8_t srl(uint8_t a)
+uint8_t srl(agb_t* gb, uint8_t a)
 {
+#ifdef _LAZY_FLAGS
+    uint8_t c = a & 0x01;
+    a >>= 1;
+
+    LAZY_FLAGS(LF_SHIFT, 0, 0, a, c);
+#else
     FLAG_C = a & 0x01;
     a >>= 1;
 
     FLAG_Z = (a == 0);
     FLAG_N = 0;
     FLAG_H = 0;
+#endif
 
     return a;
 }
 
-void bit(uint8_t reg, uint8_t b)
+void bit(agb_t* gb, uint8_t reg, uint8_t b)
 {
+    SYNC_FLAGS();
     FLAG_Z = ((reg & (0x01 << b)) == 0);
     FLAG_N = 0;
     FLAG_H = 1;
@@ -337,7 +603,7 @@ uint8_t res(uint8_t reg, uint8_t b)
     return reg &= ~(1 << b);
 }
 
-void jr(uint8_t a)
+void jr(agb_t* gb, uint8_t a)
 {
     if ((a & 0x80) == 0x80) {
         a--;
@@ -348,681 +614,861 @@ void jr(uint8_t a)
     }
 }
 
-void call(uint16_t addr)
+void call(agb_t* gb, uint16_t addr)
 {
-    push(REG_PC + 2);
+    push(gb, REG_PC);
     REG_PC = addr;
 }
 
-void rst(uint8_t a)
+void rst(agb_t* gb, uint8_t a)
 {
-    push(REG_PC);
+    push(gb, REG_PC);
     REG_PC = 0x0000 + a;
 }
 
-void ret(void)
+void ret(agb_t* gb)
+{
+    REG_PC = pop(gb);
+}
+
+uint8_t daa(agb_t* gb, uint8_t a)
+{
+    uint16_t tmp = a;
+
+    SYNC_FLAGS();
+
+    if (!FLAG_N) {
+        if (FLAG_H || ((tmp & 0x0F) > 9))
+            tmp += 6;
+        if (FLAG_C || (tmp > 0x9F))
+            tmp += 0x60;
+    } else {
+        if (FLAG_H)
+            tmp = (tmp - 6) & 0xFF;
+        if (FLAG_C)
+            tmp -= 0x60;
+    }
+
+    if (tmp & 0x100)
+        FLAG_C = 1;
+
+    FLAG_H = 0;
+
+    tmp &= 0xFF;
+
+    FLAG_Z = (tmp == 0);
+
+    return tmp;
+}
+
+#ifdef _ALU_TABLES
+/*
+ * Table-driven 8-bit arithmetic. Every entry holds the result in its low
+ * byte and the packed F register in its high byte, so ADD/ADC/SUB/SBC/CP
+ * and DAA come down to one load plus set_f(). alu_init() fills the tables
+ * on the first cpu_reset() and checks them against the helpers above; if
+ * they disagree, the helpers stay in use.
+ */
+uint16_t alu_add_tab[2][256][256]; /* [carry][a][b] */
+uint16_t alu_sub_tab[2][256][256]; /* [carry][a][b] */
+uint16_t alu_daa_tab[8][256];      /* [N:H:C][a] */
+uint8_t alu_ready;
+uint8_t alu_ok; /* Tables passed the self-check */
+
+int alu_init(agb_t* gb)
+{
+    cpu_t saved = gb->cpu;
+    int a, b, c, f, r, err = 0;
+
+    for (c = 0; c < 2; c++) {
+        for (a = 0; a < 256; a++) {
+            for (b = 0; b < 256; b++) {
+                r = a + b + c;
+                f = ((r & 0xFF) == 0) << 7;
+                f |= ((a & 0x0F) + (b & 0x0F) + c > 0x0F) << 5;
+                f |= (r > 0xFF) << 4;
+                alu_add_tab[c][a][b] = (f << 8) | (r & 0xFF);
+
+                r = a - b - c;
+                f = ((r & 0xFF) == 0) << 7 | 0x40;
+                f |= ((a & 0x0F) - (b & 0x0F) - c < 0) << 5;
+                f |= (r < 0) << 4;
+                alu_sub_tab[c][a][b] = (f << 8) | (r & 0xFF);
+            }
+        }
+    }
+
+    for (f = 0; f < 8; f++) {
+        for (a = 0; a < 256; a++) {
+            r = a;
+            c = f & 1;
+
+            if (!(f & 4)) {
+                if (c || a > 0x99) {
+                    r += 0x60;
+                    c = 1;
+                }
+                if ((f & 2) || (a & 0x0F) > 9)
+                    r += 6;
+            } else {
+                if (c)
+                    r -= 0x60;
+                if (f & 2)
+                    r -= 6;
+            }
+
+            r &= 0xFF;
+            alu_daa_tab[f][a] = ((r == 0) << 15) | ((f & 4) << 12) | (c << 12) | r;
+        }
+    }
+
+    /* Self-check against the reference helpers */
+    for (c = 0; c < 2; c++) {
+        for (a = 0; a < 256; a++) {
+            for (b = 0; b < 256; b++) {
+                set_f(gb, c << 4);
+                r = adc(gb, a, b);
+                if (((get_f(gb) << 8) | r) != alu_add_tab[c][a][b])
+                    err++;
+
+                set_f(gb, c << 4);
+                r = sbc(gb, a, b);
+                if (((get_f(gb) << 8) | r) != alu_sub_tab[c][a][b])
+                    err++;
+
+                if (c)
+                    continue;
+
+                r = add_8_8(gb, a, b);
+                if (((get_f(gb) << 8) | r) != alu_add_tab[0][a][b])
+                    err++;
+
+                r = sub(gb, a, b);
+                if (((get_f(gb) << 8) | r) != alu_sub_tab[0][a][b])
+                    err++;
+            }
+        }
+    }
+
+    for (f = 0; f < 8; f++) {
+        for (a = 0; a < 256; a++) {
+            set_f(gb, f << 4);
+            r = daa(gb, a);
+            if (((get_f(gb) << 8) | r) != alu_daa_tab[f][a])
+                err++;
+        }
+    }
+
+    gb->cpu = saved;
+    alu_ready = 1;
+    alu_ok = (err == 0);
+
+#ifdef _DEBUG
+    if (err)
+        printf("alu_init: %d mismatches\n", err);
+#endif
+
+    return err ? -1 : 0;
+}
+
+uint8_t alu_add_8_8(agb_t* gb, uint8_t a, uint8_t b)
+{
+    uint16_t r;
+
+    if (!alu_ok)
+        return add_8_8(gb, a, b);
+
+    r = alu_add_tab[0][a][b];
+    set_f(gb, r >> 8);
+    return r & 0xFF;
+}
+
+uint8_t alu_adc(agb_t* gb, uint8_t a, uint8_t b)
+{
+    uint16_t r;
+
+    if (!alu_ok)
+        return adc(gb, a, b);
+
+    r = alu_add_tab[GET_C()][a][b];
+    set_f(gb, r >> 8);
+    return r & 0xFF;
+}
+
+uint8_t alu_sub(agb_t* gb, uint8_t a, uint8_t b)
+{
+    uint16_t r;
+
+    if (!alu_ok)
+        return sub(gb, a, b);
+
+    r = alu_sub_tab[0][a][b];
+    set_f(gb, r >> 8);
+    return r & 0xFF;
+}
+
+uint8_t alu_sbc(agb_t* gb, uint8_t a, uint8_t b)
+{
+    uint16_t r;
+
+    if (!alu_ok)
+        return sbc(gb, a, b);
+
+    r = alu_sub_tab[GET_C()][a][b];
+    set_f(gb, r >> 8);
+    return r & 0xFF;
+}
+
+uint8_t alu_daa(agb_t* gb, uint8_t a)
 {
-    REG_PC = pop();
+    uint16_t r;
+
+    if (!alu_ok)
+        return daa(gb, a);
+
+    SYNC_FLAGS();
+    r = alu_daa_tab[(FLAG_N << 2) | (FLAG_H << 1) | FLAG_C][a];
+    set_f(gb, r >> 8);
+    return r & 0xFF;
 }
 
+/* The opcode handlers below use the tables */
+#define add_8_8 alu_add_8_8
+#define adc alu_adc
+#define sub alu_sub
+#define sbc alu_sbc
+#define daa alu_daa
+#endif
+
 /* 8-bit loads */
 /* LD r <- s */
-void LDbb(void) { REG_B = REG_B; }
-void LDbc(void) { REG_B = REG_C; }
-void LDbd(void) { REG_B = REG_D; }
-void LDbe(void) { REG_B = REG_E; }
-void LDbh(void) { REG_B = REG_H; }
-void LDbl(void) { REG_B = REG_L; }
-void LDba(void) { REG_B = REG_A; }
-void LDcb(void) { REG_C = REG_B; }
-void LDcc(void) { REG_C = REG_C; }
-void LDcd(void) { REG_C = REG_D; }
-void LDce(void) { REG_C = REG_E; }
-void LDch(void) { REG_C = REG_H; }
-void LDcl(void) { REG_C = REG_L; }
-void LDca(void) { REG_C = REG_A; }
-void LDdb(void) { REG_D = REG_B; }
-void LDdc(void) { REG_D = REG_C; }
-void LDdd(void) { REG_D = REG_D; }
-void LDde(void) { REG_D = REG_E; }
-void LDdh(void) { REG_D = REG_H; }
-void LDdl(void) { REG_D = REG_L; }
-void LDda(void) { REG_D = REG_A; }
-void LDeb(void) { REG_E = REG_B; }
-void LDec(void) { REG_E = REG_C; }
-void LDed(void) { REG_E = REG_D; }
-void LDee(void) { REG_E = REG_E; }
-void LDeh(void) { REG_E = REG_H; }
-void LDel(void) { REG_E = REG_L; }
-void LDea(void) { REG_E = REG_A; }
-void LDhb(void) { REG_H = REG_B; }
-void LDhc(void) { REG_H = REG_C; }
-void LDhd(void) { REG_H = REG_D; }
-void LDhe(void) { REG_H = REG_E; }
-void LDhh(void) { REG_H = REG_H; }
-void LDhl(void) { REG_H = REG_L; }
-void LDha(void) { REG_H = REG_A; }
-void LDlb(void) { REG_L = REG_B; }
-void LDlc(void) { REG_L = REG_C; }
-void LDld(void) { REG_L = REG_D; }
-void LDle(void) { REG_L = REG_E; }
-void LDlh(void) { REG_L = REG_H; }
-void LDll(void) { REG_L = REG_L; }
-void LDla(void) { REG_L = REG_A; }
-void LDab(void) { REG_A = REG_B; }
-void LDac(void) { REG_A = REG_C; }
-void LDad(void) { REG_A = REG_D; }
-void LDae(void) { REG_A = REG_E; }
-void LDah(void) { REG_A = REG_H; }
-void LDal(void) { REG_A = REG_L; }
-void LDaa(void) { REG_A = REG_A; }
-void LDbn(void) { REG_B = read_8(cpu.mmu, REG_PC++); }
-void LDcn(void) { REG_C = read_8(cpu.mmu, REG_PC++); }
-void LDdn(void) { REG_D = read_8(cpu.mmu, REG_PC++); }
-void LDen(void) { REG_E = read_8(cpu.mmu, REG_PC++); }
-void LDhn(void) { REG_H = read_8(cpu.mmu, REG_PC++); }
-void LDln(void) { REG_L = read_8(cpu.mmu, REG_PC++); }
-void LDan(void) { REG_A = read_8(cpu.mmu, REG_PC++); }
-void LDbmHL(void) { REG_B = read_8(cpu.mmu, REG_HL); }
-void LDcmHL(void) { REG_C = read_8(cpu.mmu, REG_HL); }
-void LDdmHL(void) { REG_D = read_8(cpu.mmu, REG_HL); }
-void LDemHL(void) { REG_E = read_8(cpu.mmu, REG_HL); }
-void LDhmHL(void) { REG_H = read_8(cpu.mmu, REG_HL); }
-void LDlmHL(void) { REG_L = read_8(cpu.mmu, REG_HL); }
+void LDbb(agb_t* gb) { REG_B = REG_B; }
+void LDbc(agb_t* gb) { REG_B = REG_C; }
+void LDbd(agb_t* gb) { REG_B = REG_D; }
+void LDbe(agb_t* gb) { REG_B = REG_E; }
+void LDbh(agb_t* gb) { REG_B = REG_H; }
+void LDbl(agb_t* gb) { REG_B = REG_L; }
+void LDba(agb_t* gb) { REG_B = REG_A; }
+void LDcb(agb_t* gb) { REG_C = REG_B; }
+void LDcc(agb_t* gb) { REG_C = REG_C; }
+void LDcd(agb_t* gb) { REG_C = REG_D; }
+void LDce(agb_t* gb) { REG_C = REG_E; }
+void LDch(agb_t* gb) { REG_C = REG_H; }
+void LDcl(agb_t* gb) { REG_C = REG_L; }
+void LDca(agb_t* gb) { REG_C = REG_A; }
+void LDdb(agb_t* gb) { REG_D = REG_B; }
+void LDdc(agb_t* gb) { REG_D = REG_C; }
+void LDdd(agb_t* gb) { REG_D = REG_D; }
+void LDde(agb_t* gb) { REG_D = REG_E; }
+void LDdh(agb_t* gb) { REG_D = REG_H; }
+void LDdl(agb_t* gb) { REG_D = REG_L; }
+void LDda(agb_t* gb) { REG_D = REG_A; }
+void LDeb(agb_t* gb) { REG_E = REG_B; }
+void LDec(agb_t* gb) { REG_E = REG_C; }
+void LDed(agb_t* gb) { REG_E = REG_D; }
+void LDee(agb_t* gb) { REG_E = REG_E; }
+void LDeh(agb_t* gb) { REG_E = REG_H; }
+void LDel(agb_t* gb) { REG_E = REG_L; }
+void LDea(agb_t* gb) { REG_E = REG_A; }
+void LDhb(agb_t* gb) { REG_H = REG_B; }
+void LDhc(agb_t* gb) { REG_H = REG_C; }
+void LDhd(agb_t* gb) { REG_H = REG_D; }
+void LDhe(agb_t* gb) { REG_H = REG_E; }
+void LDhh(agb_t* gb) { REG_H = REG_H; }
+void LDhl(agb_t* gb) { REG_H = REG_L; }
+void LDha(agb_t* gb) { REG_H = REG_A; }
+void LDlb(agb_t* gb) { REG_L = REG_B; }
+void LDlc(agb_t* gb) { REG_L = REG_C; }
+void LDld(agb_t* gb) { REG_L = REG_D; }
+void LDle(agb_t* gb) { REG_L = REG_E; }
+void LDlh(agb_t* gb) { REG_L = REG_H; }
+void LDll(agb_t* gb) { REG_L = REG_L; }
+void LDla(agb_t* gb) { REG_L = REG_A; }
+void LDab(agb_t* gb) { REG_A = REG_B; }
+void LDac(agb_t* gb) { REG_A = REG_C; }
+void LDad(agb_t* gb) { REG_A = REG_D; }
+void LDae(agb_t* gb) { REG_A = REG_E; }
+void LDah(agb_t* gb) { REG_A = REG_H; }
+void LDal(agb_t* gb) { REG_A = REG_L; }
+void LDaa(agb_t* gb) { REG_A = REG_A; }
+void LDbn(agb_t* gb) { REG_B = IMM_8(); }
+void LDcn(agb_t* gb) { REG_C = IMM_8(); }
+void LDdn(agb_t* gb) { REG_D = IMM_8(); }
+void LDen(agb_t* gb) { REG_E = IMM_8(); }
+void LDhn(agb_t* gb) { REG_H = IMM_8(); }
+void LDln(agb_t* gb) { REG_L = IMM_8(); }
+void LDan(agb_t* gb) { REG_A = IMM_8(); }
+void LDbmHL(agb_t* gb) { REG_B = read_8(gb->cpu.mmu, REG_HL); }
+void LDcmHL(agb_t* gb) { REG_C = read_8(gb->cpu.mmu, REG_HL); }
+void LDdmHL(agb_t* gb) { REG_D = read_8(gb->cpu.mmu, REG_HL); }
+void LDemHL(agb_t* gb) { REG_E = read_8(gb->cpu.mmu, REG_HL); }
+void LDhmHL(agb_t* gb) { REG_H = read_8(gb->cpu.mmu, REG_HL); }
+void LDlmHL(agb_t* gb) { REG_L = read_8(gb->cpu.mmu, REG_HL); }
 /* LD d <- r */
-void LDmHLb(void) { write_8(cpu.mmu, REG_HL, REG_B); }
-void LDmHLc(void) { write_8(cpu.mmu, REG_HL, REG_C); }
-void LDmHLd(void) { write_8(cpu.mmu, REG_HL, REG_D); }
-void LDmHLe(void) { write_8(cpu.mmu, REG_HL, REG_E); }
-void LDmHLh(void) { write_8(cpu.mmu, REG_HL, REG_H); }
-void LDmHLl(void) { write_8(cpu.mmu, REG_HL, REG_L); }
+void LDmHLb(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, REG_B); }
+void LDmHLc(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, REG_C); }
+void LDmHLd(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, REG_D); }
+void LDmHLe(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, REG_E); }
+void LDmHLh(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, REG_H); }
+void LDmHLl(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, REG_L); }
 /* LD d <- n */
-void LDmHLn(void) { write_8(cpu.mmu, REG_HL, read_8(cpu.mmu, REG_PC++)); }
+void LDmHLn(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, IMM_8()); }
 /* LD A <- (ss) */
-void LDamBC(void) { REG_A = read_8(cpu.mmu, REG_BC); }
-void LDamDE(void) { REG_A = read_8(cpu.mmu, REG_DE); }
-void LDamHL(void) { REG_A = read_8(cpu.mmu, REG_HL); }
-void LDamnn(void) { REG_A = read_8(cpu.mmu, read_16(cpu.mmu, REG_PC)); REG_PC += 2; }
+void LDamBC(agb_t* gb) { REG_A = read_8(gb->cpu.mmu, REG_BC); }
+void LDamDE(agb_t* gb) { REG_A = read_8(gb->cpu.mmu, REG_DE); }
+void LDamHL(agb_t* gb) { REG_A = read_8(gb->cpu.mmu, REG_HL); }
+void LDamnn(agb_t* gb) { REG_A = read_8(gb->cpu.mmu, IMM_16()); }
 /* LD (dd) <- A */
-void LDmBCa(void) { write_8(cpu.mmu, read_16(cpu.mmu, REG_BC), REG_A); }
-void LDmDEa(void) { write_8(cpu.mmu, read_16(cpu.mmu, REG_DE), REG_A); }
-void LDmHLa(void) { write_8(cpu.mmu, read_16(cpu.mmu, REG_HL), REG_A); }
-void LDmnna(void) { write_8(cpu.mmu, read_16(cpu.mmu, REG_PC), REG_A); REG_PC += 2; }
+void LDmBCa(agb_t* gb) { write_8(gb->cpu.mmu, read_16(gb->cpu.mmu, REG_BC), REG_A); }
+void LDmDEa(agb_t* gb) { write_8(gb->cpu.mmu, read_16(gb->cpu.mmu, REG_DE), REG_A); }
+void LDmHLa(agb_t* gb) { write_8(gb->cpu.mmu, read_16(gb->cpu.mmu, REG_HL), REG_A); }
+void LDmnna(agb_t* gb) { write_8(gb->cpu.mmu, IMM_16(), REG_A); }
 /* LD A <- (C) */
-void LDamc(void) { REG_A = read_8(cpu.mmu, REG_C); }
+void LDamc(agb_t* gb) { REG_A = read_8(gb->cpu.mmu, REG_C); }
 /* LD (C) <- A */
-void LDmca(void) { write_8(cpu.mmu, read_8(cpu.mmu, REG_C), REG_A); }
+void LDmca(agb_t* gb) { write_8(gb->cpu.mmu, read_8(gb->cpu.mmu, REG_C), REG_A); }
 /* LDD A <- (HL) */
-void LDDamHL(void) { REG_A = read_8(cpu.mmu, REG_HL--); }
+void LDDamHL(agb_t* gb) { REG_A = read_8(gb->cpu.mmu, REG_HL--); }
 /* LDD (HL) <- A */
-void LDDmHLa(void) { write_8(cpu.mmu, REG_HL--, REG_A); }
+void LDDmHLa(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL--, REG_A); }
 /* LDI A <- (HL) */
-void LDIamHL(void) { REG_A = read_8(cpu.mmu, REG_HL++); }
+void LDIamHL(agb_t* gb) { REG_A = read_8(gb->cpu.mmu, REG_HL++); }
 /* LDI (HL) <- A */
-void LDImHLa(void) { write_8(cpu.mmu, REG_HL++, REG_A); }
+void LDImHLa(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL++, REG_A); }
 /* LDH (n) <- A */
-void LDHmna(void) { write_8(cpu.mmu, read_8(cpu.mmu, REG_PC++) + 0xFF00, REG_A); }
+void LDHmna(agb_t* gb) { write_8(gb->cpu.mmu, IMM_8() + 0xFF00, REG_A); }
 /* LDH A <- (n) */
-void LDHamn(void) { REG_A = read_8(cpu.mmu, 0xFF00 + read_8(cpu.mmu, REG_PC++)); }
+void LDHamn(agb_t* gb) { REG_A = read_8(gb->cpu.mmu, 0xFF00 + IMM_8()); }
 
 /* 16-bit loads */
 /* LD dd, nn */
-void LDBCnn(void) { REG_BC = read_16(cpu.mmu, REG_PC); REG_PC += 2; }
-void LDDEnn(void) { REG_DE = read_16(cpu.mmu, REG_PC); REG_PC += 2; }
-void LDHLnn(void) { REG_HL = read_16(cpu.mmu, REG_PC); REG_PC += 2; }
-void LDSPnn(void) { REG_SP = read_16(cpu.mmu, REG_PC); REG_PC += 2; }
+void LDBCnn(agb_t* gb) { REG_BC = IMM_16(); }
+void LDDEnn(agb_t* gb) { REG_DE = IMM_16(); }
+void LDHLnn(agb_t* gb) { REG_HL = IMM_16(); }
+void LDSPnn(agb_t* gb) { REG_SP = IMM_16(); }
 /* LD (nn), SP */
-void LDmnnSP(void) { write_16(cpu.mmu, read_16(cpu.mmu, REG_PC), REG_SP); REG_PC += 2; }
+void LDmnnSP(agb_t* gb) { write_16(gb->cpu.mmu, IMM_16(), REG_SP); }
 /* LD SP, HL */
-void LDSPHL(void) { REG_SP = REG_HL; }
+void LDSPHL(agb_t* gb) { REG_SP = REG_HL; }
 /* LD HL, (SP + e) */
-void LDHLSPn(void) { REG_HL = add_16_8(REG_SP, read_8(cpu.mmu, REG_PC++)); }
+void LDHLSPn(agb_t* gb) { REG_HL = add_16_8(gb, REG_SP, IMM_8()); }
 /* PUSH ss */
-void PUSHBC(void) { push(REG_BC); }
-void PUSHDE(void) { push(REG_DE); }
-void PUSHHL(void) { push(REG_HL); }
-void PUSHAF(void) { push(REG_AF); }
+void PUSHBC(agb_t* gb) { push(gb, REG_BC); }
+void PUSHDE(agb_t* gb) { push(gb, REG_DE); }
+void PUSHHL(agb_t* gb) { push(gb, REG_HL); }
+void PUSHAF(agb_t* gb) { REG_F = get_f(gb); push(gb, REG_AF); }
 /* POP dd */
-void POPBC(void) { REG_BC = pop(); }
-void POPDE(void) { REG_DE = pop(); }
-void POPHL(void) { REG_HL = pop(); }
-void POPAF(void) { REG_AF = pop(); }
+void POPBC(agb_t* gb) { REG_BC = pop(gb); }
+void POPDE(agb_t* gb) { REG_DE = pop(gb); }
+void POPHL(agb_t* gb) { REG_HL = pop(gb); }
+void POPAF(agb_t* gb) { REG_AF = pop(gb); set_f(gb, REG_F); }
 
 /* 8-bit ALU */
 /* ADD A, s */
-void ADDab(void) { REG_A = add_8_8(REG_A, REG_B); }
-void ADDac(void) { REG_A = add_8_8(REG_A, REG_C); }
-void ADDad(void) { REG_A = add_8_8(REG_A, REG_D); }
-void ADDae(void) { REG_A = add_8_8(REG_A, REG_E); }
-void ADDah(void) { REG_A = add_8_8(REG_A, REG_H); }
-void ADDal(void) { REG_A = add_8_8(REG_A, REG_L); }
-void ADDaa(void) { REG_A = add_8_8(REG_A, REG_A); }
-void ADDan(void) { REG_A = add_8_8(REG_A, read_8(cpu.mmu, REG_PC++)); }
-void ADDamHL(void) { REG_A = add_8_8(REG_A, read_8(cpu.mmu, REG_HL)); }
+void ADDab(agb_t* gb) { REG_A = add_8_8(gb, REG_A, REG_B); }
+void ADDac(agb_t* gb) { REG_A = add_8_8(gb, REG_A, REG_C); }
+void ADDad(agb_t* gb) { REG_A = add_8_8(gb, REG_A, REG_D); }
+void ADDae(agb_t* gb) { REG_A = add_8_8(gb, REG_A, REG_E); }
+void ADDah(agb_t* gb) { REG_A = add_8_8(gb, REG_A, REG_H); }
+void ADDal(agb_t* gb) { REG_A = add_8_8(gb, REG_A, REG_L); }
+void ADDaa(agb_t* gb) { REG_A = add_8_8(gb, REG_A, REG_A); }
+void ADDan(agb_t* gb) { REG_A = add_8_8(gb, REG_A, IMM_8()); }
+void ADDamHL(agb_t* gb) { REG_A = add_8_8(gb, REG_A, read_8(gb->cpu.mmu, REG_HL)); }
 /* ADC A, s */
-void ADCab(void) { REG_A = adc(REG_A, REG_B); }
-void ADCac(void) { REG_A = adc(REG_A, REG_C); }
-void ADCad(void) { REG_A = adc(REG_A, REG_D); }
-void ADCae(void) { REG_A = adc(REG_A, REG_E); }
-void ADCah(void) { REG_A = adc(REG_A, REG_H); }
-void ADCal(void) { REG_A = adc(REG_A, REG_L); }
-void ADCaa(void) { REG_A = adc(REG_A, REG_A); }
-void ADCan(void) { REG_A = adc(REG_A, read_8(cpu.mmu, REG_PC++)); }
-void ADCamHL(void) { REG_A = adc(REG_A, read_8(cpu.mmu, REG_HL)); }
+void ADCab(agb_t* gb) { REG_A = adc(gb, REG_A, REG_B); }
+void ADCac(agb_t* gb) { REG_A = adc(gb, REG_A, REG_C); }
+void ADCad(agb_t* gb) { REG_A = adc(gb, REG_A, REG_D); }
+void ADCae(agb_t* gb) { REG_A = adc(gb, REG_A, REG_E); }
+void ADCah(agb_t* gb) { REG_A = adc(gb, REG_A, REG_H); }
+void ADCal(agb_t* gb) { REG_A = adc(gb, REG_A, REG_L); }
+void ADCaa(agb_t* gb) { REG_A = adc(gb, REG_A, REG_A); }
+void ADCan(agb_t* gb) { REG_A = adc(gb, REG_A, IMM_8()); }
+void ADCamHL(agb_t* gb) { REG_A = adc(gb, REG_A, read_8(gb->cpu.mmu, REG_HL)); }
 /* SUB s */
-void SUBab(void) { REG_A = sub(REG_A, REG_B); }
-void SUBac(void) { REG_A = sub(REG_A, REG_C); }
-void SUBad(void) { REG_A = sub(REG_A, REG_D); }
-void SUBae(void) { REG_A = sub(REG_A, REG_E); }
-void SUBah(void) { REG_A = sub(REG_A, REG_H); }
-void SUBal(void) { REG_A = sub(REG_A, REG_L); }
-void SUBaa(void) { REG_A = sub(REG_A, REG_A); }
-void SUBan(void) { REG_A = sub(REG_A, read_8(cpu.mmu, REG_PC++)); }
-void SUBamHL(void) { REG_A = sub(REG_A, read_8(cpu.mmu, REG_HL)); }
+void SUBab(agb_t* gb) { REG_A = sub(gb, REG_A, REG_B); }
+void SUBac(agb_t* gb) { REG_A = sub(gb, REG_A, REG_C); }
+void SUBad(agb_t* gb) { REG_A = sub(gb, REG_A, REG_D); }
+void SUBae(agb_t* gb) { REG_A = sub(gb, REG_A, REG_E); }
+void SUBah(agb_t* gb) { REG_A = sub(gb, REG_A, REG_H); }
+void SUBal(agb_t* gb) { REG_A = sub(gb, REG_A, REG_L); }
+void SUBaa(agb_t* gb) { REG_A = sub(gb, REG_A, REG_A); }
+void SUBan(agb_t* gb) { REG_A = sub(gb, REG_A, IMM_8()); }
+void SUBamHL(agb_t* gb) { REG_A = sub(gb, REG_A, read_8(gb->cpu.mmu, REG_HL)); }
 /* SBC A, s */
-void SBCab(void) { REG_A = sbc(REG_A, REG_B); }
-void SBCac(void) { REG_A = sbc(REG_A, REG_C); }
-void SBCad(void) { REG_A = sbc(REG_A, REG_D); }
-void SBCae(void) { REG_A = sbc(REG_A, REG_E); }
-void SBCah(void) { REG_A = sbc(REG_A, REG_H); }
-void SBCal(void) { REG_A = sbc(REG_A, REG_L); }
-void SBCaa(void) { REG_A = sbc(REG_A, REG_A); }
-void SBCan(void) { REG_A = sbc(REG_A, read_8(cpu.mmu, REG_PC++)); }
-void SBCamHL(void) { REG_A = sbc(REG_A, read_8(cpu.mmu, REG_HL)); }
+void SBCab(agb_t* gb) { REG_A = sbc(gb, REG_A, REG_B); }
+void SBCac(agb_t* gb) { REG_A = sbc(gb, REG_A, REG_C); }
+void SBCad(agb_t* gb) { REG_A = sbc(gb, REG_A, REG_D); }
+void SBCae(agb_t* gb) { REG_A = sbc(gb, REG_A, REG_E); }
+void SBCah(agb_t* gb) { REG_A = sbc(gb, REG_A, REG_H); }
+void SBCal(agb_t* gb) { REG_A = sbc(gb, REG_A, REG_L); }
+void SBCaa(agb_t* gb) { REG_A = sbc(gb, REG_A, REG_A); }
+void SBCan(agb_t* gb) { REG_A = sbc(gb, REG_A, IMM_8()); }
+void SBCamHL(agb_t* gb) { REG_A = sbc(gb, REG_A, read_8(gb->cpu.mmu, REG_HL)); }
 /* AND s */
-void ANDb(void) { REG_A = and(REG_A, REG_B); }
-void ANDc(void) { REG_A = and(REG_A, REG_C); }
-void ANDd(void) { REG_A = and(REG_A, REG_D); }
-void ANDe(void) { REG_A = and(REG_A, REG_E); }
-void ANDh(void) { REG_A = and(REG_A, REG_H); }
-void ANDl(void) { REG_A = and(REG_A, REG_L); }
-void ANDa(void) { REG_A = and(REG_A, REG_A); }
-void ANDn(void) { REG_A = and(REG_A, read_8(cpu.mmu, REG_PC++)); }
-void ANDmHL(void) { REG_A = and(REG_A, read_8(cpu.mmu, REG_HL)); }
+void ANDb(agb_t* gb) { REG_A = and(gb, REG_A, REG_B); }
+void ANDc(agb_t* gb) { REG_A = and(gb, REG_A, REG_C); }
+void ANDd(agb_t* gb) { REG_A = and(gb, REG_A, REG_D); }
+void ANDe(agb_t* gb) { REG_A = and(gb, REG_A, REG_E); }
+void ANDh(agb_t* gb) { REG_A = and(gb, REG_A, REG_H); }
+void ANDl(agb_t* gb) { REG_A = and(gb, REG_A, REG_L); }
+void ANDa(agb_t* gb) { REG_A = and(gb, REG_A, REG_A); }
+void ANDn(agb_t* gb) { REG_A = and(gb, REG_A, IMM_8()); }
+void ANDmHL(agb_t* gb) { REG_A = and(gb, REG_A, read_8(gb->cpu.mmu, REG_HL)); }
 /* OR s */
-void ORb(void) { REG_A = or(REG_A, REG_B); }
-void ORc(void) { REG_A = or(REG_A, REG_C); }
-void ORd(void) { REG_A = or(REG_A, REG_D); }
-void ORe(void) { REG_A = or(REG_A, REG_E); }
-void ORh(void) { REG_A = or(REG_A, REG_H); }
-void ORl(void) { REG_A = or(REG_A, REG_L); }
-void ORa(void) { REG_A = or(REG_A, REG_A); }
-void ORn(void) { REG_A = or(REG_A, read_8(cpu.mmu, REG_PC++)); }
-void ORmHL(void) { REG_A = or(REG_A, read_8(cpu.mmu, REG_HL)); }
+void ORb(agb_t* gb) { REG_A = or(gb, REG_A, REG_B); }
+void ORc(agb_t* gb) { REG_A = or(gb, REG_A, REG_C); }
+void ORd(agb_t* gb) { REG_A = or(gb, REG_A, REG_D); }
+void ORe(agb_t* gb) { REG_A = or(gb, REG_A, REG_E); }
+void ORh(agb_t* gb) { REG_A = or(gb, REG_A, REG_H); }
+void ORl(agb_t* gb) { REG_A = or(gb, REG_A, REG_L); }
+void ORa(agb_t* gb) { REG_A = or(gb, REG_A, REG_A); }
+void ORn(agb_t* gb) { REG_A = or(gb, REG_A, IMM_8()); }
+void ORmHL(agb_t* gb) { REG_A = or(gb, REG_A, read_8(gb->cpu.mmu, REG_HL)); }
 /* XOR s */
-void XORb(void) { REG_A = xor(REG_A, REG_B); }
-void XORc(void) { REG_A = xor(REG_A, REG_C); }
-void XORd(void) { REG_A = xor(REG_A, REG_D); }
-void XORe(void) { REG_A = xor(REG_A, REG_E); }
-void XORh(void) { REG_A = xor(REG_A, REG_H); }
-void XORl(void) { REG_A = xor(REG_A, REG_L); }
-void XORa(void) { REG_A = xor(REG_A, REG_A); }
-void XORn(void) { REG_A = xor(REG_A, read_8(cpu.mmu, REG_PC++)); }
-void XORmHL(void) { REG_A = xor(REG_A, read_8(cpu.mmu, REG_HL)); }
+void XORb(agb_t* gb) { REG_A = xor(gb, REG_A, REG_B); }
+void XORc(agb_t* gb) { REG_A = xor(gb, REG_A, REG_C); }
+void XORd(agb_t* gb) { REG_A = xor(gb, REG_A, REG_D); }
+void XORe(agb_t* gb) { REG_A = xor(gb, REG_A, REG_E); }
+void XORh(agb_t* gb) { REG_A = xor(gb, REG_A, REG_H); }
+void XORl(agb_t* gb) { REG_A = xor(gb, REG_A, REG_L); }
+void XORa(agb_t* gb) { REG_A = xor(gb, REG_A, REG_A); }
+void XORn(agb_t* gb) { REG_A = xor(gb, REG_A, IMM_8()); }
+void XORmHL(agb_t* gb) { REG_A = xor(gb, REG_A, read_8(gb->cpu.mmu, REG_HL)); }
 /* CP s */
-void CPb(void) { sub(REG_A, REG_B); }
-void CPc(void) { sub(REG_A, REG_C); }
-void CPd(void) { sub(REG_A, REG_D); }
-void CPe(void) { sub(REG_A, REG_E); }
-void CPh(void) { sub(REG_A, REG_H); }
-void CPl(void) { sub(REG_A, REG_L); }
-void CPa(void) { sub(REG_A, REG_A); }
-void CPn(void) { sub(REG_A, read_8(cpu.mmu, REG_PC++)); }
-void CPmHL(void) { sub(REG_A, read_8(cpu.mmu, REG_HL)); }
+void CPb(agb_t* gb) { sub(gb, REG_A, REG_B); }
+void CPc(agb_t* gb) { sub(gb, REG_A, REG_C); }
+void CPd(agb_t* gb) { sub(gb, REG_A, REG_D); }
+void CPe(agb_t* gb) { sub(gb, REG_A, REG_E); }
+void CPh(agb_t* gb) { sub(gb, REG_A, REG_H); }
+void CPl(agb_t* gb) { sub(gb, REG_A, REG_L); }
+void CPa(agb_t* gb) { sub(gb, REG_A, REG_A); }
+void CPn(agb_t* gb) { sub(gb, REG_A, IMM_8()); }
+void CPmHL(agb_t* gb) { sub(gb, REG_A, read_8(gb->cpu.mmu, REG_HL)); }
 /* INC s */
-void INCb(void) { REG_B = inc_8(REG_B); }
-void INCc(void) { REG_C = inc_8(REG_C); }
-void INCd(void) { REG_D = inc_8(REG_D); }
-void INCe(void) { REG_E = inc_8(REG_E); }
-void INCh(void) { REG_H = inc_8(REG_H); }
-void INCl(void) { REG_L = inc_8(REG_L); }
-void INCa(void) { REG_A = inc_8(REG_A); }
-void INCmHL(void) { write_8(cpu.mmu, REG_HL, inc_8(read_8(cpu.mmu, REG_HL))); }
+void INCb(agb_t* gb) { REG_B = inc_8(gb, REG_B); }
+void INCc(agb_t* gb) { REG_C = inc_8(gb, REG_C); }
+void INCd(agb_t* gb) { REG_D = inc_8(gb, REG_D); }
+void INCe(agb_t* gb) { REG_E = inc_8(gb, REG_E); }
+void INCh(agb_t* gb) { REG_H = inc_8(gb, REG_H); }
+void INCl(agb_t* gb) { REG_L = inc_8(gb, REG_L); }
+void INCa(agb_t* gb) { REG_A = inc_8(gb, REG_A); }
+void INCmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, inc_8(gb, read_8(gb->cpu.mmu, REG_HL))); }
 /* DEC s */
-void DECb(void) { REG_B = dec_8(REG_B); }
-void DECc(void) { REG_C = dec_8(REG_C); }
-void DECd(void) { REG_D = dec_8(REG_D); }
-void DECe(void) { REG_E = dec_8(REG_E); }
-void DECh(void) { REG_H = dec_8(REG_H); }
-void DECl(void) { REG_L = dec_8(REG_L); }
-void DECa(void) { REG_A = dec_8(REG_A); }
-void DECmHL(void) { write_8(cpu.mmu, REG_HL, dec_8(read_8(cpu.mmu, REG_HL))); }
+void DECb(agb_t* gb) { REG_B = dec_8(gb, REG_B); }
+void DECc(agb_t* gb) { REG_C = dec_8(gb, REG_C); }
+void DECd(agb_t* gb) { REG_D = dec_8(gb, REG_D); }
+void DECe(agb_t* gb) { REG_E = dec_8(gb, REG_E); }
+void DECh(agb_t* gb) { REG_H = dec_8(gb, REG_H); }
+void DECl(agb_t* gb) { REG_L = dec_8(gb, REG_L); }
+void DECa(agb_t* gb) { REG_A = dec_8(gb, REG_A); }
+void DECmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, dec_8(gb, read_8(gb->cpu.mmu, REG_HL))); }
 
 /* 16-bit arithmetic */
 /* ADD HL, ss */
-void ADDHLBC(void) { REG_HL = add_16_16(REG_HL, REG_BC); }
-void ADDHLDE(void) { REG_HL = add_16_16(REG_HL, REG_DE); }
-void ADDHLHL(void) { REG_HL = add_16_16(REG_HL, REG_HL); }
-void ADDHLSP(void) { REG_HL = add_16_16(REG_HL, REG_SP); }
+void ADDHLBC(agb_t* gb) { REG_HL = add_16_16(gb, REG_HL, REG_BC); }
+void ADDHLDE(agb_t* gb) { REG_HL = add_16_16(gb, REG_HL, REG_DE); }
+void ADDHLHL(agb_t* gb) { REG_HL = add_16_16(gb, REG_HL, REG_HL); }
+void ADDHLSP(agb_t* gb) { REG_HL = add_16_16(gb, REG_HL, REG_SP); }
 /* ADD SP, e */
-void ADDSPn(void) { REG_SP = add_16_8(REG_SP, read_8(cpu.mmu, REG_PC++)); }
+void ADDSPn(agb_t* gb) { REG_SP = add_16_8(gb, REG_SP, IMM_8()); }
 /* INC ss */
-void INCBC(void) { REG_BC = inc_16(REG_BC); }
-void INCDE(void) { REG_DE = inc_16(REG_DE); }
-void INCHL(void) { REG_HL = inc_16(REG_HL); }
-void INCSP(void) { REG_SP = inc_16(REG_SP); }
+void INCBC(agb_t* gb) { REG_BC = inc_16(REG_BC); }
+void INCDE(agb_t* gb) { REG_DE = inc_16(REG_DE); }
+void INCHL(agb_t* gb) { REG_HL = inc_16(REG_HL); }
+void INCSP(agb_t* gb) { REG_SP = inc_16(REG_SP); }
 /* DEC ss */
-void DECBC(void) { REG_BC = dec_16(REG_BC); }
-void DECDE(void) { REG_DE = dec_16(REG_DE); }
-void DECHL(void) { REG_HL = dec_16(REG_HL); }
-void DECSP(void) { REG_SP = dec_16(REG_SP); }
+void DECBC(agb_t* gb) { REG_BC = dec_16(REG_BC); }
+void DECDE(agb_t* gb) { REG_DE = dec_16(REG_DE); }
+void DECHL(agb_t* gb) { REG_HL = dec_16(REG_HL); }
+void DECSP(agb_t* gb) { REG_SP = dec_16(REG_SP); }
 
 /* Misc */
 /* SWAP s */
-void SWAPb(void) { REG_B = swap(REG_B); }
-void SWAPc(void) { REG_C = swap(REG_C); }
-void SWAPd(void) { REG_D = swap(REG_D); }
-void SWAPe(void) { REG_E = swap(REG_E); }
-void SWAPh(void) { REG_H = swap(REG_H); }
-void SWAPl(void) { REG_L = swap(REG_L); }
-void SWAPa(void) { REG_A = swap(REG_A); }
-void SWAPmHL(void) { write_8(cpu.mmu, REG_HL, swap(read_8(cpu.mmu, REG_HL))); }
+void SWAPb(agb_t* gb) { REG_B = swap(gb, REG_B); }
+void SWAPc(agb_t* gb) { REG_C = swap(gb, REG_C); }
+void SWAPd(agb_t* gb) { REG_D = swap(gb, REG_D); }
+void SWAPe(agb_t* gb) { REG_E = swap(gb, REG_E); }
+void SWAPh(agb_t* gb) { REG_H = swap(gb, REG_H); }
+void SWAPl(agb_t* gb) { REG_L = swap(gb, REG_L); }
+void SWAPa(agb_t* gb) { REG_A = swap(gb, REG_A); }
+void SWAPmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, swap(gb, read_8(gb->cpu.mmu, REG_HL))); }
 /* DAA */
-void DAA(void)
-{
-    uint8_t tmp = REG_A;
-    if (!FLAG_N) {
-        if (FLAG_H || ((tmp & 0x0F) > 9))
-            tmp += 6;
-        if (FLAG_C || (tmp > 0x9F))
-            tmp += 0x60;
-    } else {
-        if (FLAG_H)
-            tmp = (tmp - 6) & 0xFF;
-        if (FLAG_C)
-            tmp -= 0x60;
-    }
-
-    if (tmp & 0x100)
-        FLAG_C = 1;
-
-    FLAG_H = 0;
-
-    tmp &= 0xFF;
-
-    FLAG_Z = (tmp == 0);
-
-    REG_A = tmp;
-}
+void DAA(agb_t* gb) { REG_A = daa(gb, REG_A); }
 /* CPL */
-void CPL(void) { REG_A = ~REG_A; FLAG_N = 1; FLAG_H = 1; }
+void CPL(agb_t* gb) { SYNC_FLAGS(); REG_A = ~REG_A; FLAG_N = 1; FLAG_H = 1; }
 /* CCF */
-void CCF(void) { FLAG_C = (FLAG_C == 0); FLAG_N = 0; FLAG_H = 0; }
+void CCF(agb_t* gb) { SYNC_FLAGS(); FLAG_C = (FLAG_C == 0); FLAG_N = 0; FLAG_H = 0; }
 /* SCF */
-void SCF(void) { FLAG_C = 1; FLAG_N = 0; FLAG_H = 0; }
+void SCF(agb_t* gb) { SYNC_FLAGS(); FLAG_C = 1; FLAG_N = 0; FLAG_H = 0; }
 /* NOP */
-void NOP(void) { /* No operation */ }
+void NOP(agb_t* gb) { (void)gb; /* No operation */ }
 /* HALT */
-void HALT(void) { cpu.halt = 1; }
+void HALT(agb_t* gb) { gb->cpu.halt = 1; END_SLICE(); }
 /* STOP */
-void STOP(void) { REG_PC++; cpu.stop = 1; }
+void STOP(agb_t* gb) { REG_PC++; gb->cpu.stop = 1; }
 /* DI */
-void DI(void) { cpu.ime = 0; }
+void DI(agb_t* gb) { gb->cpu.ime = 0; }
 /* EI */
-void EI(void) { cpu.ime = 1; }
+void EI(agb_t* gb) { gb->cpu.ei = 1; END_SLICE(); }
 
 /* Rotates and shifts */
 /* RLCA */
-void RLCA(void) { REG_A = rlc(REG_A); FLAG_Z = 0; }
+void RLCA(agb_t* gb) { REG_A = rlc(gb, REG_A); CLEAR_Z(); }
 /* RLA */
-void RLA(void) { REG_A = rl(REG_A); FLAG_Z = 0; }
+void RLA(agb_t* gb) { REG_A = rl(gb, REG_A); CLEAR_Z(); }
 /* RRCA */
-void RRCA(void) { REG_A = rrc(REG_A); FLAG_Z = 0; }
+void RRCA(agb_t* gb) { REG_A = rrc(gb, REG_A); CLEAR_Z(); }
 /* RRA */
-void RRA(void) { REG_A = rr(REG_A); FLAG_Z = 0; }
+void RRA(agb_t* gb) { REG_A = rr(gb, REG_A); CLEAR_Z(); }
 /* RLC s */
-void RLCb(void) { REG_B = rlc(REG_B); }
-void RLCc(void) { REG_C = rlc(REG_C); }
-void RLCd(void) { REG_D = rlc(REG_D); }
-void RLCe(void) { REG_E = rlc(REG_E); }
-void RLCh(void) { REG_H = rlc(REG_H); }
-void RLCl(void) { REG_L = rlc(REG_L); }
-void RLCa(void) { REG_A = rlc(REG_A); }
-void RLCmHL(void) { write_8(cpu.mmu, REG_HL, rlc(read_8(cpu.mmu, REG_HL))); }
+void RLCb(agb_t* gb) { REG_B = rlc(gb, REG_B); }
+void RLCc(agb_t* gb) { REG_C = rlc(gb, REG_C); }
+void RLCd(agb_t* gb) { REG_D = rlc(gb, REG_D); }
+void RLCe(agb_t* gb) { REG_E = rlc(gb, REG_E); }
+void RLCh(agb_t* gb) { REG_H = rlc(gb, REG_H); }
+void RLCl(agb_t* gb) { REG_L = rlc(gb, REG_L); }
+void RLCa(agb_t* gb) { REG_A = rlc(gb, REG_A); }
+void RLCmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, rlc(gb, read_8(gb->cpu.mmu, REG_HL))); }
 /* RL s */
-void RLb(void) { REG_B = rl(REG_B); }
-void RLc(void) { REG_C = rl(REG_C); }
-void RLd(void) { REG_D = rl(REG_D); }
-void RLe(void) { REG_E = rl(REG_E); }
-void RLh(void) { REG_H = rl(REG_H); }
-void RLl(void) { REG_L = rl(REG_L); }
-void RLa(void) { REG_A = rl(REG_A); }
-void RLmHL(void) { write_8(cpu.mmu, REG_HL, rl(read_8(cpu.mmu, REG_HL))); }
+void RLb(agb_t* gb) { REG_B = rl(gb, REG_B); }
+void RLc(agb_t* gb) { REG_C = rl(gb, REG_C); }
+void RLd(agb_t* gb) { REG_D = rl(gb, REG_D); }
+void RLe(agb_t* gb) { REG_E = rl(gb, REG_E); }
+void RLh(agb_t* gb) { REG_H = rl(gb, REG_H); }
+void RLl(agb_t* gb) { REG_L = rl(gb, REG_L); }
+void RLa(agb_t* gb) { REG_A = rl(gb, REG_A); }
+void RLmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, rl(gb, read_8(gb->cpu.mmu, REG_HL))); }
 /* RRC s */
-void RRCb(void) { REG_B = rrc(REG_B); }
-void RRCc(void) { REG_C = rrc(REG_C); }
-void RRCd(void) { REG_D = rrc(REG_D); }
-void RRCe(void) { REG_E = rrc(REG_E); }
-void RRCh(void) { REG_H = rrc(REG_H); }
-void RRCl(void) { REG_L = rrc(REG_L); }
-void RRCa(void) { REG_A = rrc(REG_A); }
-void RRCmHL(void) { write_8(cpu.mmu, REG_HL, rrc(read_8(cpu.mmu, REG_HL))); }
+void RRCb(agb_t* gb) { REG_B = rrc(gb, REG_B); }
+void RRCc(agb_t* gb) { REG_C = rrc(gb, REG_C); }
+void RRCd(agb_t* gb) { REG_D = rrc(gb, REG_D); }
+void RRCe(agb_t* gb) { REG_E = rrc(gb, REG_E); }
+void RRCh(agb_t* gb) { REG_H = rrc(gb, REG_H); }
+void RRCl(agb_t* gb) { REG_L = rrc(gb, REG_L); }
+void RRCa(agb_t* gb) { REG_A = rrc(gb, REG_A); }
+void RRCmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, rrc(gb, read_8(gb->cpu.mmu, REG_HL))); }
 /* RR s */
-void RRb(void) { REG_B = rr(REG_B); }
-void RRc(void) { REG_C = rr(REG_C); }
-void RRd(void) { REG_D = rr(REG_D); }
-void RRe(void) { REG_E = rr(REG_E); }
-void RRh(void) { REG_H = rr(REG_H); }
-void RRl(void) { REG_L = rr(REG_L); }
-void RRa(void) { REG_A = rr(REG_A); }
-void RRmHL(void) { write_8(cpu.mmu, REG_HL, rr(read_8(cpu.mmu, REG_HL))); }
+void RRb(agb_t* gb) { REG_B = rr(gb, REG_B); }
+void RRc(agb_t* gb) { REG_C = rr(gb, REG_C); }
+void RRd(agb_t* gb) { REG_D = rr(gb, REG_D); }
+void RRe(agb_t* gb) { REG_E = rr(gb, REG_E); }
+void RRh(agb_t* gb) { REG_H = rr(gb, REG_H); }
+void RRl(agb_t* gb) { REG_L = rr(gb, REG_L); }
+void RRa(agb_t* gb) { REG_A = rr(gb, REG_A); }
+void RRmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, rr(gb, read_8(gb->cpu.mmu, REG_HL))); }
 /* SLA s */
-void SLAb(void) { REG_B = sla(REG_B); }
-void SLAc(void) { REG_C = sla(REG_C); }
-void SLAd(void) { REG_D = sla(REG_D); }
-void SLAe(void) { REG_E = sla(REG_E); }
-void SLAh(void) { REG_H = sla(REG_H); }
-void SLAl(void) { REG_L = sla(REG_L); }
-void SLAa(void) { REG_A = sla(REG_A); }
-void SLAmHL(void) { write_8(cpu.mmu, REG_HL, sla(read_8(cpu.mmu, REG_HL))); }
+void SLAb(agb_t* gb) { REG_B = sla(gb, REG_B); }
+void SLAc(agb_t* gb) { REG_C = sla(gb, REG_C); }
+void SLAd(agb_t* gb) { REG_D = sla(gb, REG_D); }
+void SLAe(agb_t* gb) { REG_E = sla(gb, REG_E); }
+void SLAh(agb_t* gb) { REG_H = sla(gb, REG_H); }
+void SLAl(agb_t* gb) { REG_L = sla(gb, REG_L); }
+void SLAa(agb_t* gb) { REG_A = sla(gb, REG_A); }
+void SLAmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, sla(gb, read_8(gb->cpu.mmu, REG_HL))); }
 /* SRA s */
-void SRAb(void) { REG_B = sra(REG_B); }
-void SRAc(void) { REG_C = sra(REG_C); }
-void SRAd(void) { REG_D = sra(REG_D); }
-void SRAe(void) { REG_E = sra(REG_E); }
-void SRAh(void) { REG_H = sra(REG_H); }
-void SRAl(void) { REG_L = sra(REG_L); }
-void SRAa(void) { REG_A = sra(REG_A); }
-void SRAmHL(void) { write_8(cpu.mmu, REG_HL, sra(read_8(cpu.mmu, REG_HL))); }
+void SRAb(agb_t* gb) { REG_B = sra(gb, REG_B); }
+void SRAc(agb_t* gb) { REG_C = sra(gb, REG_C); }
+void SRAd(agb_t* gb) { REG_D = sra(gb, REG_D); }
+void SRAe(agb_t* gb) { REG_E = sra(gb, REG_E); }
+void SRAh(agb_t* gb) { REG_H = sra(gb, REG_H); }
+void SRAl(agb_t* gb) { REG_L = sra(gb, REG_L); }
+void SRAa(agb_t* gb) { REG_A = sra(gb, REG_A); }
+void SRAmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, sra(gb, read_8(gb->cpu.mmu, REG_HL))); }
 /* SRL s */
-void SRLb(void) { REG_B = srl(REG_B); }
-void SRLc(void) { REG_C = srl(REG_C); }
-void SRLd(void) { REG_D = srl(REG_D); }
-void SRLe(void) { REG_E = srl(REG_E); }
-void SRLh(void) { REG_H = srl(REG_H); }
-void SRLl(void) { REG_L = srl(REG_L); }
-void SRLa(void) { REG_A = srl(REG_A); }
-void SRLmHL(void) { write_8(cpu.mmu, REG_HL, srl(read_8(cpu.mmu, REG_HL))); }
+void SRLb(agb_t* gb) { REG_B = srl(gb, REG_B); }
+void SRLc(agb_t* gb) { REG_C = srl(gb, REG_C); }
+void SRLd(agb_t* gb) { REG_D = srl(gb, REG_D); }
+void SRLe(agb_t* gb) { REG_E = srl(gb, REG_E); }
+void SRLh(agb_t* gb) { REG_H = srl(gb, REG_H); }
+void SRLl(agb_t* gb) { REG_L = srl(gb, REG_L); }
+void SRLa(agb_t* gb) { REG_A = srl(gb, REG_A); }
+void SRLmHL(agb_t* gb) { write_8(gb->cpu.mmu, REG_HL, srl(gb, read_8(gb->cpu.mmu, REG_HL))); }
 
 /* Bit manipulation */
 /* BIT b, s */
-void BIT0b(void) { bit(REG_B, 0); }
-void BIT0c(void) { bit(REG_C, 0); }
-void BIT0d(void) { bit(REG_D, 0); }
-void BIT0e(void) { bit(REG_E, 0); }
-void BIT0h(void) { bit(REG_H, 0); }
-void BIT0l(void) { bit(REG_L, 0); }
-void BIT0a(void) { bit(REG_A, 0); }
-void BIT0mHL(void) { bit(read_8(cpu.mmu, REG_HL), 0); }
-void BIT1b(void) { bit(REG_B, 1); }
-void BIT1c(void) { bit(REG_C, 1); }
-void BIT1d(void) { bit(REG_D, 1); }
-void BIT1e(void) { bit(REG_E, 1); }
-void BIT1h(void) { bit(REG_H, 1); }
-void BIT1l(void) { bit(REG_L, 1); }
-void BIT1a(void) { bit(REG_A, 1); }
-void BIT1mHL(void) { bit(read_8(cpu.mmu, REG_HL), 1); }
-void BIT2b(void) { bit(REG_B, 2); }
-void BIT2c(void) { bit(REG_C, 2); }
-void BIT2d(void) { bit(REG_D, 2); }
-void BIT2e(void) { bit(REG_E, 2); }
-void BIT2h(void) { bit(REG_H, 2); }
-void BIT2l(void) { bit(REG_L, 2); }
-void BIT2a(void) { bit(REG_A, 2); }
-void BIT2mHL(void) { bit(read_8(cpu.mmu, REG_HL), 2); }
-void BIT3b(void) { bit(REG_B, 3); }
-void BIT3c(void) { bit(REG_C, 3); }
-void BIT3d(void) { bit(REG_D, 3); }
-void BIT3e(void) { bit(REG_E, 3); }
-void BIT3h(void) { bit(REG_H, 3); }
-void BIT3l(void) { bit(REG_L, 3); }
-void BIT3a(void) { bit(REG_A, 3); }
-void BIT3mHL(void) { bit(read_8(cpu.mmu, REG_HL), 3); }
-void BIT4b(void) { bit(REG_B, 4); }
-void BIT4c(void) { bit(REG_C, 4); }
-void BIT4d(void) { bit(REG_D, 4); }
-void BIT4e(void) { bit(REG_E, 4); }
-void BIT4h(void) { bit(REG_H, 4); }
-void BIT4l(void) { bit(REG_L, 4); }
-void BIT4a(void) { bit(REG_A, 4); }
-void BIT4mHL(void) { bit(read_8(cpu.mmu, REG_HL), 4); }
-void BIT5b(void) { bit(REG_B, 5); }
-void BIT5c(void) { bit(REG_C, 5); }
-void BIT5d(void) { bit(REG_D, 5); }
-void BIT5e(void) { bit(REG_E, 5); }
-void BIT5h(void) { bit(REG_H, 5); }
-void BIT5l(void) { bit(REG_L, 5); }
-void BIT5a(void) { bit(REG_A, 5); }
-void BIT5mHL(void) { bit(read_8(cpu.mmu, REG_HL), 5); }
-void BIT6b(void) { bit(REG_B, 6); }
-void BIT6c(void) { bit(REG_C, 6); }
-void BIT6d(void) { bit(REG_D, 6); }
-void BIT6e(void) { bit(REG_E, 6); }
-void BIT6h(void) { bit(REG_H, 6); }
-void BIT6l(void) { bit(REG_L, 6); }
-void BIT6a(void) { bit(REG_A, 6); }
-void BIT6mHL(void) { bit(read_8(cpu.mmu, REG_HL), 6); }
-void BIT7b(void) { bit(REG_B, 7); }
-void BIT7c(void) { bit(REG_C, 7); }
-void BIT7d(void) { bit(REG_D, 7); }
-void BIT7e(void) { bit(REG_E, 7); }
-void BIT7h(void) { bit(REG_H, 7); }
-void BIT7l(void) { bit(REG_L, 7); }
-void BIT7a(void) { bit(REG_A, 7); }
-void BIT7mHL(void) { bit(read_8(cpu.mmu, REG_HL), 7); }
+void BIT0b(agb_t* gb) { bit(gb, REG_B, 0); }
+void BIT0c(agb_t* gb) { bit(gb, REG_C, 0); }
+void BIT0d(agb_t* gb) { bit(gb, REG_D, 0); }
+void BIT0e(agb_t* gb) { bit(gb, REG_E, 0); }
+void BIT0h(agb_t* gb) { bit(gb, REG_H, 0); }
+void BIT0l(agb_t* gb) { bit(gb, REG_L, 0); }
+void BIT0a(agb_t* gb) { bit(gb, REG_A, 0); }
+void BIT0mHL(agb_t* gb) { bit(gb, read_8(gb->cpu.mmu, REG_HL), 0); }
+void BIT1b(agb_t* gb) { bit(gb, REG_B, 1); }
+void BIT1c(agb_t* gb) { bit(gb, REG_C, 1); }
+void BIT1d(agb_t* gb) { bit(gb, REG_D, 1); }
+void BIT1e(agb_t* gb) { bit(gb, REG_E, 1); }
+void BIT1h(agb_t* gb) { bit(gb, REG_H, 1); }
+void BIT1l(agb_t* gb) { bit(gb, REG_L, 1); }
+void BIT1a(agb_t* gb) { bit(gb, REG_A, 1); }
+void BIT1mHL(agb_t* gb) { bit(gb, read_8(gb->cpu.mmu, REG_HL), 1); }
+void BIT2b(agb_t* gb) { bit(gb, REG_B, 2); }
+void BIT2c(agb_t* gb) { bit(gb, REG_C, 2); }
+void BIT2d(agb_t* gb) { bit(gb, REG_D, 2); }
+void BIT2e(agb_t* gb) { bit(gb, REG_E, 2); }
+void BIT2h(agb_t* gb) { bit(gb, REG_H, 2); }
+void BIT2l(agb_t* gb) { bit(gb, REG_L, 2); }
+void BIT2a(agb_t* gb) { bit(gb, REG_A, 2); }
+void BIT2mHL(agb_t* gb) { bit(gb, read_8(gb->cpu.mmu, REG_HL), 2); }
+void BIT3b(agb_t* gb) { bit(gb, REG_B, 3); }
+void BIT3c(agb_t* gb) { bit(gb, REG_C, 3); }
+void BIT3d(agb_t* gb) { bit(gb, REG_D, 3); }
+void BIT3e(agb_t* gb) { bit(gb, REG_E, 3); }
+void BIT3h(agb_t* gb) { bit(gb, REG_H, 3); }
+void BIT3l(agb_t* gb) { bit(gb, REG_L, 3); }
+void BIT3a(agb_t* gb) { bit(gb, REG_A, 3); }
+void BIT3mHL(agb_t* gb) { bit(gb, read_8(gb->cpu.mmu, REG_HL), 3); }
+void BIT4b(agb_t* gb) { bit(gb, REG_B, 4); }
+void BIT4c(agb_t* gb) { bit(gb, REG_C, 4); }
+void BIT4d(agb_t* gb) { bit(gb, REG_D, 4); }
+void BIT4e(agb_t* gb) { bit(gb, REG_E, 4); }
+void BIT4h(agb_t* gb) { bit(gb, REG_H, 4); }
+void BIT4l(agb_t* gb) { bit(gb, REG_L, 4); }
+void BIT4a(agb_t* gb) { bit(gb, REG_A, 4); }
+void BIT4mHL(agb_t* gb) { bit(gb, read_8(gb->cpu.mmu, REG_HL), 4); }
+void BIT5b(agb_t* gb) { bit(gb, REG_B, 5); }
+void BIT5c(agb_t* gb) { bit(gb, REG_C, 5); }
+void BIT5d(agb_t* gb) { bit(gb, REG_D, 5); }
+void BIT5e(agb_t* gb) { bit(gb, REG_E, 5); }
+void BIT5h(agb_t* gb) { bit(gb, REG_H, 5); }
+void BIT5l(agb_t* gb) { bit(gb, REG_L, 5); }
+void BIT5a(agb_t* gb) { bit(gb, REG_A, 5); }
+void BIT5mHL(agb_t* gb) { bit(gb, read_8(gb->cpu.mmu, REG_HL), 5); }
+void BIT6b(agb_t* gb) { bit(gb, REG_B, 6); }
+void BIT6c(agb_t* gb) { bit(gb, REG_C, 6); }
+void BIT6d(agb_t* gb) { bit(gb, REG_D, 6); }
+void BIT6e(agb_t* gb) { bit(gb, REG_E, 6); }
+void BIT6h(agb_t* gb) { bit(gb, REG_H, 6); }
+void BIT6l(agb_t* gb) { bit(gb, REG_L, 6); }
+void BIT6a(agb_t* gb) { bit(gb, REG_A, 6); }
+void BIT6mHL(agb_t* gb) { bit(gb, read_8(gb->cpu.mmu, REG_HL), 6); }
+void BIT7b(agb_t* gb) { bit(gb, REG_B, 7); }
+void BIT7c(agb_t* gb) { bit(gb, REG_C, 7); }
+void BIT7d(agb_t* gb) { bit(gb, REG_D, 7); }
+void BIT7e(agb_t* gb) { bit(gb, REG_E, 7); }
+void BIT7h(agb_t* gb) { bit(gb, REG_H, 7); }
+void BIT7l(agb_t* gb) { bit(gb, REG_L, 7); }
+void BIT7a(agb_t* gb) { bit(gb, REG_A, 7); }
+void BIT7mHL(agb_t* gb) { bit(gb, read_8(gb->cpu.mmu, REG_HL), 7); }
 /* SET b, s */
-void SET0b(void) { set(REG_B, 0); }
-void SET0c(void) { set(REG_C, 0); }
-void SET0d(void) { set(REG_D, 0); }
-void SET0e(void) { set(REG_E, 0); }
-void SET0h(void) { set(REG_H, 0); }
-void SET0l(void) { set(REG_L, 0); }
-void SET0a(void) { set(REG_A, 0); }
-void SET0mHL(void) { set(read_8(cpu.mmu, REG_HL), 0); }
-void SET1b(void) { set(REG_B, 1); }
-void SET1c(void) { set(REG_C, 1); }
-void SET1d(void) { set(REG_D, 1); }
-void SET1e(void) { set(REG_E, 1); }
-void SET1h(void) { set(REG_H, 1); }
-void SET1l(void) { set(REG_L, 1); }
-void SET1a(void) { set(REG_A, 1); }
-void SET1mHL(void) { set(read_8(cpu.mmu, REG_HL), 1); }
-void SET2b(void) { set(REG_B, 2); }
-void SET2c(void) { set(REG_C, 2); }
-void SET2d(void) { set(REG_D, 2); }
-void SET2e(void) { set(REG_E, 2); }
-void SET2h(void) { set(REG_H, 2); }
-void SET2l(void) { set(REG_L, 2); }
-void SET2a(void) { set(REG_A, 2); }
-void SET2mHL(void) { set(read_8(cpu.mmu, REG_HL), 2); }
-void SET3b(void) { set(REG_B, 3); }
-void SET3c(void) { set(REG_C, 3); }
-void SET3d(void) { set(REG_D, 3); }
-void SET3e(void) { set(REG_E, 3); }
-void SET3h(void) { set(REG_H, 3); }
-void SET3l(void) { set(REG_L, 3); }
-void SET3a(void) { set(REG_A, 3); }
-void SET3mHL(void) { set(read_8(cpu.mmu, REG_HL), 3); }
-void SET4b(void) { set(REG_B, 4); }
-void SET4c(void) { set(REG_C, 4); }
-void SET4d(void) { set(REG_D, 4); }
-void SET4e(void) { set(REG_E, 4); }
-void SET4h(void) { set(REG_H, 4); }
-void SET4l(void) { set(REG_L, 4); }
-void SET4a(void) { set(REG_A, 4); }
-void SET4mHL(void) { set(read_8(cpu.mmu, REG_HL), 4); }
-void SET5b(void) { set(REG_B, 5); }
-void SET5c(void) { set(REG_C, 5); }
-void SET5d(void) { set(REG_D, 5); }
-void SET5e(void) { set(REG_E, 5); }
-void SET5h(void) { set(REG_H, 5); }
-void SET5l(void) { set(REG_L, 5); }
-void SET5a(void) { set(REG_A, 5); }
-void SET5mHL(void) { set(read_8(cpu.mmu, REG_HL), 5); }
-void SET6b(void) { set(REG_B, 6); }
-void SET6c(void) { set(REG_C, 6); }
-void SET6d(void) { set(REG_D, 6); }
-void SET6e(void) { set(REG_E, 6); }
-void SET6h(void) { set(REG_H, 6); }
-void SET6l(void) { set(REG_L, 6); }
-void SET6a(void) { set(REG_A, 6); }
-void SET6mHL(void) { set(read_8(cpu.mmu, REG_HL), 6); }
-void SET7b(void) { set(REG_B, 7); }
-void SET7c(void) { set(REG_C, 7); }
-void SET7d(void) { set(REG_D, 7); }
-void SET7e(void) { set(REG_E, 7); }
-void SET7h(void) { set(REG_H, 7); }
-void SET7l(void) { set(REG_L, 7); }
-void SET7a(void) { set(REG_A, 7); }
-void SET7mHL(void) { set(read_8(cpu.mmu, REG_HL), 7); }
+void SET0b(agb_t* gb) { set(REG_B, 0); }
+void SET0c(agb_t* gb) { set(REG_C, 0); }
+void SET0d(agb_t* gb) { set(REG_D, 0); }
+void SET0e(agb_t* gb) { set(REG_E, 0); }
+void SET0h(agb_t* gb) { set(REG_H, 0); }
+void SET0l(agb_t* gb) { set(REG_L, 0); }
+void SET0a(agb_t* gb) { set(REG_A, 0); }
+void SET0mHL(agb_t* gb) { set(read_8(gb->cpu.mmu, REG_HL), 0); }
+void SET1b(agb_t* gb) { set(REG_B, 1); }
+void SET1c(agb_t* gb) { set(REG_C, 1); }
+void SET1d(agb_t* gb) { set(REG_D, 1); }
+void SET1e(agb_t* gb) { set(REG_E, 1); }
+void SET1h(agb_t* gb) { set(REG_H, 1); }
+void SET1l(agb_t* gb) { set(REG_L, 1); }
+void SET1a(agb_t* gb) { set(REG_A, 1); }
+void SET1mHL(agb_t* gb) { set(read_8(gb->cpu.mmu, REG_HL), 1); }
+void SET2b(agb_t* gb) { set(REG_B, 2); }
+void SET2c(agb_t* gb) { set(REG_C, 2); }
+void SET2d(agb_t* gb) { set(REG_D, 2); }
+void SET2e(agb_t* gb) { set(REG_E, 2); }
+void SET2h(agb_t* gb) { set(REG_H, 2); }
+void SET2l(agb_t* gb) { set(REG_L, 2); }
+void SET2a(agb_t* gb) { set(REG_A, 2); }
+void SET2mHL(agb_t* gb) { set(read_8(gb->cpu.mmu, REG_HL), 2); }
+void SET3b(agb_t* gb) { set(REG_B, 3); }
+void SET3c(agb_t* gb) { set(REG_C, 3); }
+void SET3d(agb_t* gb) { set(REG_D, 3); }
+void SET3e(agb_t* gb) { set(REG_E, 3); }
+void SET3h(agb_t* gb) { set(REG_H, 3); }
+void SET3l(agb_t* gb) { set(REG_L, 3); }
+void SET3a(agb_t* gb) { set(REG_A, 3); }
+void SET3mHL(agb_t* gb) { set(read_8(gb->cpu.mmu, REG_HL), 3); }
+void SET4b(agb_t* gb) { set(REG_B, 4); }
+void SET4c(agb_t* gb) { set(REG_C, 4); }
+void SET4d(agb_t* gb) { set(REG_D, 4); }
+void SET4e(agb_t* gb) { set(REG_E, 4); }
+void SET4h(agb_t* gb) { set(REG_H, 4); }
+void SET4l(agb_t* gb) { set(REG_L, 4); }
+void SET4a(agb_t* gb) { set(REG_A, 4); }
+void SET4mHL(agb_t* gb) { set(read_8(gb->cpu.mmu, REG_HL), 4); }
+void SET5b(agb_t* gb) { set(REG_B, 5); }
+void SET5c(agb_t* gb) { set(REG_C, 5); }
+void SET5d(agb_t* gb) { set(REG_D, 5); }
+void SET5e(agb_t* gb) { set(REG_E, 5); }
+void SET5h(agb_t* gb) { set(REG_H, 5); }
+void SET5l(agb_t* gb) { set(REG_L, 5); }
+void SET5a(agb_t* gb) { set(REG_A, 5); }
+void SET5mHL(agb_t* gb) { set(read_8(gb->cpu.mmu, REG_HL), 5); }
+void SET6b(agb_t* gb) { set(REG_B, 6); }
+void SET6c(agb_t* gb) { set(REG_C, 6); }
+void SET6d(agb_t* gb) { set(REG_D, 6); }
+void SET6e(agb_t* gb) { set(REG_E, 6); }
+void SET6h(agb_t* gb) { set(REG_H, 6); }
+void SET6l(agb_t* gb) { set(REG_L, 6); }
+void SET6a(agb_t* gb) { set(REG_A, 6); }
+void SET6mHL(agb_t* gb) { set(read_8(gb->cpu.mmu, REG_HL), 6); }
+void SET7b(agb_t* gb) { set(REG_B, 7); }
+void SET7c(agb_t* gb) { set(REG_C, 7); }
+void SET7d(agb_t* gb) { set(REG_D, 7); }
+void SET7e(agb_t* gb) { set(REG_E, 7); }
+void SET7h(agb_t* gb) { set(REG_H, 7); }
+void SET7l(agb_t* gb) { set(REG_L, 7); }
+void SET7a(agb_t* gb) { set(REG_A, 7); }
+void SET7mHL(agb_t* gb) { set(read_8(gb->cpu.mmu, REG_HL), 7); }
 /* RES b, s */
-void RES0b(void) { res(REG_B, 0); }
-void RES0c(void) { res(REG_C, 0); }
-void RES0d(void) { res(REG_D, 0); }
-void RES0e(void) { res(REG_E, 0); }
-void RES0h(void) { res(REG_H, 0); }
-void RES0l(void) { res(REG_L, 0); }
-void RES0a(void) { res(REG_A, 0); }
-void RES0mHL(void) { res(read_8(cpu.mmu, REG_HL), 0); }
-void RES1b(void) { res(REG_B, 1); }
-void RES1c(void) { res(REG_C, 1); }
-void RES1d(void) { res(REG_D, 1); }
-void RES1e(void) { res(REG_E, 1); }
-void RES1h(void) { res(REG_H, 1); }
-void RES1l(void) { res(REG_L, 1); }
-void RES1a(void) { res(REG_A, 1); }
-void RES1mHL(void) { res(read_8(cpu.mmu, REG_HL), 1); }
-void RES2b(void) { res(REG_B, 2); }
-void RES2c(void) { res(REG_C, 2); }
-void RES2d(void) { res(REG_D, 2); }
-void RES2e(void) { res(REG_E, 2); }
-void RES2h(void) { res(REG_H, 2); }
-void RES2l(void) { res(REG_L, 2); }
-void RES2a(void) { res(REG_A, 2); }
-void RES2mHL(void) { res(read_8(cpu.mmu, REG_HL), 2); }
-void RES3b(void) { res(REG_B, 3); }
-void RES3c(void) { res(REG_C, 3); }
-void RES3d(void) { res(REG_D, 3); }
-void RES3e(void) { res(REG_E, 3); }
-void RES3h(void) { res(REG_H, 3); }
-void RES3l(void) { res(REG_L, 3); }
-void RES3a(void) { res(REG_A, 3); }
-void RES3mHL(void) { res(read_8(cpu.mmu, REG_HL), 3); }
-void RES4b(void) { res(REG_B, 4); }
-void RES4c(void) { res(REG_C, 4); }
-void RES4d(void) { res(REG_D, 4); }
-void RES4e(void) { res(REG_E, 4); }
-void RES4h(void) { res(REG_H, 4); }
-void RES4l(void) { res(REG_L, 4); }
-void RES4a(void) { res(REG_A, 4); }
-void RES4mHL(void) { res(read_8(cpu.mmu, REG_HL), 4); }
-void RES5b(void) { res(REG_B, 5); }
-void RES5c(void) { res(REG_C, 5); }
-void RES5d(void) { res(REG_D, 5); }
-void RES5e(void) { res(REG_E, 5); }
-void RES5h(void) { res(REG_H, 5); }
-void RES5l(void) { res(REG_L, 5); }
-void RES5a(void) { res(REG_A, 5); }
-void RES5mHL(void) { res(read_8(cpu.mmu, REG_HL), 5); }
-void RES6b(void) { res(REG_B, 6); }
-void RES6c(void) { res(REG_C, 6); }
-void RES6d(void) { res(REG_D, 6); }
-void RES6e(void) { res(REG_E, 6); }
-void RES6h(void) { res(REG_H, 6); }
-void RES6l(void) { res(REG_L, 6); }
-void RES6a(void) { res(REG_A, 6); }
-void RES6mHL(void) { res(read_8(cpu.mmu, REG_HL), 6); }
-void RES7b(void) { res(REG_B, 7); }
-void RES7c(void) { res(REG_C, 7); }
-void RES7d(void) { res(REG_D, 7); }
-void RES7e(void) { res(REG_E, 7); }
-void RES7h(void) { res(REG_H, 7); }
-void RES7l(void) { res(REG_L, 7); }
-void RES7a(void) { res(REG_A, 7); }
-void RES7mHL(void) { res(read_8(cpu.mmu, REG_HL), 7); }
+void RES0b(agb_t* gb) { res(REG_B, 0); }
+void RES0c(agb_t* gb) { res(REG_C, 0); }
+void RES0d(agb_t* gb) { res(REG_D, 0); }
+void RES0e(agb_t* gb) { res(REG_E, 0); }
+void RES0h(agb_t* gb) { res(REG_H, 0); }
+void RES0l(agb_t* gb) { res(REG_L, 0); }
+void RES0a(agb_t* gb) { res(REG_A, 0); }
+void RES0mHL(agb_t* gb) { res(read_8(gb->cpu.mmu, REG_HL), 0); }
+void RES1b(agb_t* gb) { res(REG_B, 1); }
+void RES1c(agb_t* gb) { res(REG_C, 1); }
+void RES1d(agb_t* gb) { res(REG_D, 1); }
+void RES1e(agb_t* gb) { res(REG_E, 1); }
+void RES1h(agb_t* gb) { res(REG_H, 1); }
+void RES1l(agb_t* gb) { res(REG_L, 1); }
+void RES1a(agb_t* gb) { res(REG_A, 1); }
+void RES1mHL(agb_t* gb) { res(read_8(gb->cpu.mmu, REG_HL), 1); }
+void RES2b(agb_t* gb) { res(REG_B, 2); }
+void RES2c(agb_t* gb) { res(REG_C, 2); }
+void RES2d(agb_t* gb) { res(REG_D, 2); }
+void RES2e(agb_t* gb) { res(REG_E, 2); }
+void RES2h(agb_t* gb) { res(REG_H, 2); }
+void RES2l(agb_t* gb) { res(REG_L, 2); }
+void RES2a(agb_t* gb) { res(REG_A, 2); }
+void RES2mHL(agb_t* gb) { res(read_8(gb->cpu.mmu, REG_HL), 2); }
+void RES3b(agb_t* gb) { res(REG_B, 3); }
+void RES3c(agb_t* gb) { res(REG_C, 3); }
+void RES3d(agb_t* gb) { res(REG_D, 3); }
+void RES3e(agb_t* gb) { res(REG_E, 3); }
+void RES3h(agb_t* gb) { res(REG_H, 3); }
+void RES3l(agb_t* gb) { res(REG_L, 3); }
+void RES3a(agb_t* gb) { res(REG_A, 3); }
+void RES3mHL(agb_t* gb) { res(read_8(gb->cpu.mmu, REG_HL), 3); }
+void RES4b(agb_t* gb) { res(REG_B, 4); }
+void RES4c(agb_t* gb) { res(REG_C, 4); }
+void RES4d(agb_t* gb) { res(REG_D, 4); }
+void RES4e(agb_t* gb) { res(REG_E, 4); }
+void RES4h(agb_t* gb) { res(REG_H, 4); }
+void RES4l(agb_t* gb) { res(REG_L, 4); }
+void RES4a(agb_t* gb) { res(REG_A, 4); }
+void RES4mHL(agb_t* gb) { res(read_8(gb->cpu.mmu, REG_HL), 4); }
+void RES5b(agb_t* gb) { res(REG_B, 5); }
+void RES5c(agb_t* gb) { res(REG_C, 5); }
+void RES5d(agb_t* gb) { res(REG_D, 5); }
+void RES5e(agb_t* gb) { res(REG_E, 5); }
+void RES5h(agb_t* gb) { res(REG_H, 5); }
+void RES5l(agb_t* gb) { res(REG_L, 5); }
+void RES5a(agb_t* gb) { res(REG_A, 5); }
+void RES5mHL(agb_t* gb) { res(read_8(gb->cpu.mmu, REG_HL), 5); }
+void RES6b(agb_t* gb) { res(REG_B, 6); }
+void RES6c(agb_t* gb) { res(REG_C, 6); }
+void RES6d(agb_t* gb) { res(REG_D, 6); }
+void RES6e(agb_t* gb) { res(REG_E, 6); }
+void RES6h(agb_t* gb) { res(REG_H, 6); }
+void RES6l(agb_t* gb) { res(REG_L, 6); }
+void RES6a(agb_t* gb) { res(REG_A, 6); }
+void RES6mHL(agb_t* gb) { res(read_8(gb->cpu.mmu, REG_HL), 6); }
+void RES7b(agb_t* gb) { res(REG_B, 7); }
+void RES7c(agb_t* gb) { res(REG_C, 7); }
+void RES7d(agb_t* gb) { res(REG_D, 7); }
+void RES7e(agb_t* gb) { res(REG_E, 7); }
+void RES7h(agb_t* gb) { res(REG_H, 7); }
+void RES7l(agb_t* gb) { res(REG_L, 7); }
+void RES7a(agb_t* gb) { res(REG_A, 7); }
+void RES7mHL(agb_t* gb) { res(read_8(gb->cpu.mmu, REG_HL), 7); }
 
 /* Jumps */
 /* JP nn */
-void JPnn(void) { REG_PC = read_16(cpu.mmu, REG_PC); }
+void JPnn(agb_t* gb) { REG_PC = IMM_16(); }
 /* JP cc, nn */
-void JPZnn(void)
+void JPZnn(agb_t* gb)
 {
-    if (FLAG_Z) {
-        REG_PC = read_16(cpu.mmu, REG_PC);
-        cpu.ins_clock.m = 4;
+    if (GET_Z()) {
+        REG_PC = IMM_16();
+        gb->cpu.ins_clock.m = 4;
         return;
     }
 
     REG_PC += 2;
 }
-void JPCnn(void)
+void JPCnn(agb_t* gb)
 {
-    if (FLAG_C) {
-        REG_PC = read_16(cpu.mmu, REG_PC);
-        cpu.ins_clock.m = 4;
+    if (GET_C()) {
+        REG_PC = IMM_16();
+        gb->cpu.ins_clock.m = 4;
         return;
     }
 
     REG_PC += 2;
 }
-void JPNZnn(void)
+void JPNZnn(agb_t* gb)
 {
-    if (!FLAG_Z) {
-        REG_PC = read_16(cpu.mmu, REG_PC);
-        cpu.ins_clock.m = 4;
+    if (!GET_Z()) {
+        REG_PC = IMM_16();
+        gb->cpu.ins_clock.m = 4;
         return;
     }
 
     REG_PC += 2;
 }
-void JPNCnn(void)
+void JPNCnn(agb_t* gb)
 {
-    if (!FLAG_C) {
-        REG_PC = read_16(cpu.mmu, REG_PC);
-        cpu.ins_clock.m = 4;
+    if (!GET_C()) {
+        REG_PC = IMM_16();
+        gb->cpu.ins_clock.m = 4;
         return;
     }
 
     REG_PC += 2;
 }
 /* JP (HL) */
-void JPmHL(void)
+void JPmHL(agb_t* gb)
 {
     /* Why is this called JP (HL) and not JP HL? */
     REG_PC = REG_HL;
 }
 /* JR e */
-void JRn(void) { jr(read_8(cpu.mmu, REG_PC)); REG_PC++; }
+void JRn(agb_t* gb) { jr(gb, IMM_8()); }
 /* JR cc, e */
-void JRZn(void)
+void JRZn(agb_t* gb)
 {
-    if (FLAG_Z) {
-        jr(read_8(cpu.mmu, REG_PC));
-        REG_PC++;
-        cpu.ins_clock.m = 4;
+    if (GET_Z()) {
+        jr(gb, IMM_8());
+        gb->cpu.ins_clock.m = 4;
         return;
     }
 
     REG_PC++;
 }
-void JRCn(void)
+void JRCn(agb_t* gb)
 {
-    if (FLAG_C) {
-        jr(read_8(cpu.mmu, REG_PC));
-        REG_PC++;
-        cpu.ins_clock.m = 4;
+    if (GET_C()) {
+        jr(gb, IMM_8());
+        gb->cpu.ins_clock.m = 4;
         return;
     }
 
     REG_PC++;
 }
-void JRNZn(void)
+void JRNZn(agb_t* gb)
 {
-    if (!FLAG_Z) {
-        jr(read_8(cpu.mmu, REG_PC));
-        REG_PC++;
-        cpu.ins_clock.m = 4;
+    if (!GET_Z()) {
+        jr(gb, IMM_8());
+        gb->cpu.ins_clock.m = 4;
         return;
     }
 
     REG_PC++;
 }
-void JRNCn(void)
+void JRNCn(agb_t* gb)
 {
-    if (!FLAG_C) {
-        jr(read_8(cpu.mmu, REG_PC));
-        REG_PC++;
-        cpu.ins_clock.m = 4;
+    if (!GET_C()) {
+        jr(gb, IMM_8());
+        gb->cpu.ins_clock.m = 4;
         return;
     }
 
@@ -1031,43 +1477,43 @@ void JRNCn(void)
 
 /* Calls */
 /* CALL nn */
-void CALLnn(void) { call(read_16(cpu.mmu, REG_PC)); }
+void CALLnn(agb_t* gb) { call(gb, IMM_16()); }
 /* CALL cc, nn */
-void CALLZnn(void)
+void CALLZnn(agb_t* gb)
 {
-    if (FLAG_Z) {
-        call(read_8(cpu.mmu, REG_PC));
-        cpu.ins_clock.m = 12;
+    if (GET_Z()) {
+        call(gb, IMM_16());
+        gb->cpu.ins_clock.m = 12;
         return;
     }
 
     REG_PC += 2;
 }
-void CALLCnn(void)
+void CALLCnn(agb_t* gb)
 {
-    if (FLAG_C) {
-        call(read_8(cpu.mmu, REG_PC));
-        cpu.ins_clock.m = 12;
+    if (GET_C()) {
+        call(gb, IMM_16());
+        gb->cpu.ins_clock.m = 12;
         return;
     }
 
     REG_PC += 2;
 }
-void CALLNZnn(void)
+void CALLNZnn(agb_t* gb)
 {
-    if (!FLAG_Z) {
-        call(read_8(cpu.mmu, REG_PC));
-        cpu.ins_clock.m = 12;
+    if (!GET_Z()) {
+        call(gb, IMM_16());
+        gb->cpu.ins_clock.m = 12;
         return;
     }
 
     REG_PC += 2;
 }
-void CALLNCnn(void)
+void CALLNCnn(agb_t* gb)
 {
-    if (!FLAG_C) {
-        call(read_8(cpu.mmu, REG_PC));
-        cpu.ins_clock.m = 12;
+    if (!GET_C()) {
+        call(gb, IMM_16());
+        gb->cpu.ins_clock.m = 12;
         return;
     }
 
@@ -1076,52 +1522,52 @@ void CALLNCnn(void)
 
 /* Restarts */
 /* RST f */
-void RST0(void) { rst(0x00); }
-void RST8(void) { rst(0x08); }
-void RST10(void) { rst(0x10); }
-void RST18(void) { rst(0x18); }
-void RST20(void) { rst(0x20); }
-void RST28(void) { rst(0x28); }
-void RST30(void) { rst(0x30); }
-void RST38(void) { rst(0x38); }
+void RST0(agb_t* gb) { rst(gb, 0x00); }
+void RST8(agb_t* gb) { rst(gb, 0x08); }
+void RST10(agb_t* gb) { rst(gb, 0x10); }
+void RST18(agb_t* gb) { rst(gb, 0x18); }
+void RST20(agb_t* gb) { rst(gb, 0x20); }
+void RST28(agb_t* gb) { rst(gb, 0x28); }
+void RST30(agb_t* gb) { rst(gb, 0x30); }
+void RST38(agb_t* gb) { rst(gb, 0x38); }
 
 /* Returns */
 /* RET */
-void RET(void) { ret(); }
+void RET(agb_t* gb) { ret(gb); }
 /* RET cc */
-void RETZ(void)
+void RETZ(agb_t* gb)
 {
-    if (FLAG_Z) {
-        ret();
-        cpu.ins_clock.m = 12;
+    if (GET_Z()) {
+        ret(gb);
+        gb->cpu.ins_clock.m = 12;
     }
 }
-void RETC(void)
+void RETC(agb_t* gb)
 {
-    if (FLAG_C) {
-        ret();
-        cpu.ins_clock.m = 12;
+    if (GET_C()) {
+        ret(gb);
+        gb->cpu.ins_clock.m = 12;
     }
 }
-void RETNZ(void)
+void RETNZ(agb_t* gb)
 {
-    if (!FLAG_Z) {
-        ret();
-        cpu.ins_clock.m = 12;
+    if (!GET_Z()) {
+        ret(gb);
+        gb->cpu.ins_clock.m = 12;
     }
 }
-void RETNC(void)
+void RETNC(agb_t* gb)
 {
-    if (!FLAG_C) {
-        ret();
-        cpu.ins_clock.m = 12;
+    if (!GET_C()) {
+        ret(gb);
+        gb->cpu.ins_clock.m = 12;
     }
 }
 /* RETI */
-void RETI(void) { ret(); cpu.ime = 1; }
+void RETI(agb_t* gb) { ret(gb); gb->cpu.ime = 1; END_SLICE(); }
 
 /* Lookup table for two-byte opcodes */
-void (*cb_ops[256])() = {
+void (* const cb_ops[256])(agb_t* gb) = {
 /*   |   0   |   1  |   2  |   3  |   4  |   5  |    6   |   7  |   8  |   9  |   A  |   B  |   C  |   D  |    E   |   F  | */
 /* 0 */ RLCb , RLCc , RLCd , RLCe , RLCh , RLCl , RLCmHL , RLCa , RRCb , RRCc , RRCd , RRCe , RRCh , RRCl , RRCmHL , RRCa ,
 /* 1 */ RLb  , RLc  , RLd  , RLe  , RLh  , RLl  , RLmHL  , RLa  , RRb  , RRc  , RRd  , RRe  , RRh  , RRl  , RRmHL  , RRa  ,
@@ -1142,14 +1588,14 @@ void (*cb_ops[256])() = {
 };
 
 /* Jump to 2-byte opcodes */
-void CB(void)
+void CB(agb_t* gb)
 {
-    cpu.cb_op = read_8(cpu.mmu, REG_PC++);
-    (*cb_ops[cpu.cb_op])();
+    gb->cpu.cb_op = read_8(gb->cpu.mmu, REG_PC++);
+    (*cb_ops[gb->cpu.cb_op])(gb);
 }
 
 /* Table of function pointers indexed by opcode */
-void (*ops[256])() = {
+void (* const ops[256])(agb_t* gb) = {
 /*    |    0   |   1   |    2   |   3   |    4    |   5   |    6   |   7   |    8   |    9   |    A   |   B  |    C   |   D   |    E   |   F  | */
 /* 0 */ NOP    , LDBCnn, LDmBCa , INCBC , INCb    , DECb  , LDbn   , RLCA  , LDmnnSP, ADDHLBC, LDamBC , DECBC, INCc   , DECc  , LDcn   , RRCA ,
 /* 1 */ STOP   , LDDEnn, LDmDEa , INCDE , INCd    , DECd  , LDdn   , RLA   , JRn    , ADDHLDE, LDamDE , DECDE, INCe   , DECe  , LDen   , RRA  ,
@@ -1171,7 +1617,7 @@ void (*ops[256])() = {
 
 
 /* M clock values */
-uint8_t timings_m[256] = {
+const uint8_t timings_m[256] = {
 /*   |  0 | 1 | 2 | 3 | 4 | 5 | 6 | 7 | 8 | 9 | A | B| C | D | E| F | */
 /* 0 */  4, 12,  8,  8,  4,  4,  8,  4, 20,  8,  8, 8,  4,  4, 8,  4,
 /* 1 */  4, 12,  8,  8,  4,  4,  8,  4, 12,  8,  8, 8,  4,  4, 8,  4,
@@ -1192,7 +1638,7 @@ uint8_t timings_m[256] = {
 };
 
 /* M clock values (0xCB prefix) */
-uint8_t cb_timings_m[256] = {
+const uint8_t cb_timings_m[256] = {
 /*   | 0 | 1| 2| 3| 4| 5| 6 | 7| 8| 9| A| B| C| D| E | F| */
 /* 0 */ 8, 8, 8, 8, 8, 8, 16, 8, 8, 8, 8, 8, 8, 8, 16, 8,
 /* 1 */ 8, 8, 8, 8, 8, 8, 16, 8, 8, 8, 8, 8, 8, 8, 16, 8,
@@ -1212,19 +1658,491 @@ uint8_t cb_timings_m[256] = {
 /* F */ 8, 8, 8, 8, 8, 8, 16, 8, 8, 8, 8, 8, 8, 8, 16, 8
 };
 
-
-/* T clock values */
-uint8_t timings_t[/*256*/] = {
-    0 /* Stuff */
+#ifdef _DECODE_CACHE
+/* Instruction lengths in bytes */
+const uint8_t op_len[256] = {
+/*   | 0| 1| 2| 3| 4| 5| 6| 7| 8| 9| A| B| C| D| E| F| */
+/* 0 */ 1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,
+/* 1 */ 2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+/* 2 */ 2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+/* 3 */ 2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
+/* 4 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 5 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 6 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 7 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 8 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* 9 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* A */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* B */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+/* C */ 1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,
+/* D */ 1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 1, 2, 1,
+/* E */ 2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1,
+/* F */ 2, 1, 1, 1, 1, 1, 2, 1, 2, 1, 3, 1, 1, 1, 2, 1
 };
+#endif
+
+#ifdef _THREADED
+/* Opcode lists for the threaded core, in table order. X is expanded once
+   per opcode with its number in hex; the 0xCB prefix goes through P. */
+#define OPS_ROW(X, h) \
+    X(h##0) X(h##1) X(h##2) X(h##3) X(h##4) X(h##5) X(h##6) X(h##7) \
+    X(h##8) X(h##9) X(h##A) X(h##B) X(h##C) X(h##D) X(h##E) X(h##F)
+
+#define OPS_ALL(X, P) \
+    OPS_ROW(X, 0) OPS_ROW(X, 1) OPS_ROW(X, 2) OPS_ROW(X, 3) \
+    OPS_ROW(X, 4) OPS_ROW(X, 5) OPS_ROW(X, 6) OPS_ROW(X, 7) \
+    OPS_ROW(X, 8) OPS_ROW(X, 9) OPS_ROW(X, A) OPS_ROW(X, B) \
+    X(C0) X(C1) X(C2) X(C3) X(C4) X(C5) X(C6) X(C7) \
+    X(C8) X(C9) X(CA) P(CB) X(CC) X(CD) X(CE) X(CF) \
+    OPS_ROW(X, D) OPS_ROW(X, E) OPS_ROW(X, F)
+
+#define CB_OPS_ALL(X) \
+    OPS_ROW(X, 0) OPS_ROW(X, 1) OPS_ROW(X, 2) OPS_ROW(X, 3) \
+    OPS_ROW(X, 4) OPS_ROW(X, 5) OPS_ROW(X, 6) OPS_ROW(X, 7) \
+    OPS_ROW(X, 8) OPS_ROW(X, 9) OPS_ROW(X, A) OPS_ROW(X, B) \
+    OPS_ROW(X, C) OPS_ROW(X, D) OPS_ROW(X, E) OPS_ROW(X, F)
+#endif
+
+#ifdef _DECODE_CACHE
+/*
+ * Decoded block cache. Straight-line runs of code are decoded once into
+ * handler, operand and clock triples and replayed from there, keyed by PC
+ * and the ROM bank they came from. A block never crosses a 256-byte page,
+ * and is decoded again once that page has been written (see write_8); a
+ * write to it or a bank switch while the block runs cuts it short. This
+ * core takes precedence over _THREADED.
+ */
+/* ROM bank the code at addr comes from */
+uint16_t block_bank(agb_t* gb, uint16_t addr)
+{
+    if (addr < 0x0100 && gb->cpu.mmu->in_bios)
+        return 0xFFFF;
+    if (addr < 0x4000)
+        return gb->cpu.mmu->rom_bank0;
+    if (addr < 0x8000)
+        return gb->cpu.mmu->rom_bank;
+    return 0;
+}
+
+/* Decode the instruction at addr, returns its length */
+uint8_t decode(agb_t* gb, uint16_t addr, dinsn_t* d)
+{
+    d->op = read_8(gb->cpu.mmu, addr);
+
+    if (d->op == 0xCB) {
+        d->imm = read_8(gb->cpu.mmu, addr + 1);
+        d->fn = cb_ops[d->imm];
+        d->m = cb_timings_m[d->imm];
+        d->len = 2;
+        d->size = 2;
+        return 2;
+    }
+
+    d->fn = ops[d->op];
+    d->m = timings_m[d->op];
+    d->len = 1;
+    d->size = op_len[d->op];
+
+    if (d->size == 2)
+        d->imm = read_8(gb->cpu.mmu, addr + 1);
+    else if (d->size == 3)
+        d->imm = read_16(gb->cpu.mmu, addr + 1);
+    else
+        d->imm = 0;
+
+    return d->size;
+}
+
+/* Whether an opcode has to be the last one in its block */
+uint8_t ends_block(uint8_t op)
+{
+    switch (op) {
+    case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+    case 0x76: case 0xC0: case 0xC2: case 0xC3: case 0xC4: case 0xC7:
+    case 0xC8: case 0xC9: case 0xCA: case 0xCC: case 0xCD: case 0xCF:
+    case 0xD0: case 0xD2: case 0xD4: case 0xD7: case 0xD8: case 0xD9:
+    case 0xDA: case 0xDC: case 0xDF: case 0xE7: case 0xE9: case 0xEF:
+    case 0xF3: case 0xF7: case 0xFB: case 0xFF:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Whether d leaves memory, SP and the interrupt state alone */
+uint8_t pure(const dinsn_t* d)
+{
+    if (d->op == 0xCB)
+        return (d->imm & 7) != 6 || (d->imm >= 0x40 && d->imm < 0x80);
+
+    switch (d->op) {
+    case 0x02: case 0x08: case 0x10: case 0x12: case 0x22: case 0x31:
+    case 0x32: case 0x33: case 0x34: case 0x35: case 0x36: case 0x3B:
+    case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75:
+    case 0x76: case 0x77: case 0xC0: case 0xC1: case 0xC4: case 0xC5:
+    case 0xC7: case 0xC8: case 0xC9: case 0xCC: case 0xCD: case 0xCF:
+    case 0xD0: case 0xD1: case 0xD4: case 0xD5: case 0xD7: case 0xD8:
+    case 0xD9: case 0xDC: case 0xDF: case 0xE0: case 0xE1: case 0xE2:
+    case 0xE5: case 0xE7: case 0xE8: case 0xE9: case 0xEA: case 0xEF:
+    case 0xF1: case 0xF3: case 0xF5: case 0xF7: case 0xF9: case 0xFB:
+    case 0xFF:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+/* Whether b is a loop that only reads memory and branches back to its own
+   start, ending at end. Once one pass leaves the registers as they were,
+   every pass does until something else changes memory. */
+uint8_t block_spins(const dblock_t* b, uint16_t end)
+{
+    const dinsn_t* d = &b->ins[b->count - 1];
+    uint16_t target;
+    uint8_t i;
+
+    switch (d->op) {
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+        target = end + (int8_t)d->imm;
+        break;
+    case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+        target = d->imm;
+        break;
+    default:
+        return 0;
+    }
+
+    if (target != b->pc)
+        return 0;
+
+    for (i = 0; i < b->count; i++)
+        if (!pure(&b->ins[i]))
+            return 0;
+
+    return 1;
+}
+
+/* Decode the block starting at pc. Leaves b empty if its first
+   instruction straddles two pages. */
+void decode_block(agb_t* gb, dblock_t* b, uint16_t pc, uint16_t bank)
+{
+    uint16_t addr = pc;
+    uint16_t pre_m = 0;
+    uint16_t pre_t = 0;
+    uint16_t cb = 0;
+    dinsn_t* d;
+    uint8_t len;
+
+    b->pc = pc;
+    b->bank = bank;
+    b->gen = gb->cpu.mmu->page_gen[pc >> 8];
+    b->count = 0;
+#ifdef _JIT
+    b->hits = 0;
+    b->epoch = gb->jit.epoch;
+    b->jit = NULL;
+#endif
+
+    do {
+        d = &b->ins[b->count];
+        len = decode(gb, addr, d);
+
+        if ((addr & 0xFF) + len > 0x100)
+            break;
+
+        if (d->op == 0xCB)
+            cb = 0x100 | d->imm;
+
+        d->pre_m = pre_m;
+        d->pre_t = pre_t;
+        d->cb = cb;
+        pre_m += d->m;
+        pre_t += (d->m + 3) / 4;
+
+        b->count++;
+        addr += len;
+    } while (b->count < DBLOCK_MAX && !ends_block(d->op) && (addr & 0xFF));
+
+    b->spin = b->count > 0 && block_spins(b, addr);
+}
+
+void dcache_flush(agb_t* gb)
+{
+    uint16_t i;
+
+    for (i = 0; i < DCACHE_SIZE; i++)
+        gb->dcache[i].count = 0;
+}
+
+/* Interpret n decoded instructions from the current PC on, stopping early
+   once left M clocks are used up, the slice is ended or the code is
+   written to. Returns the M clocks spent. */
+uint32_t run_block(agb_t* gb, const dinsn_t* d, uint8_t n, uint32_t left)
+{
+    const uint32_t* gen = &gb->cpu.mmu->page_gen[REG_PC >> 8];
+    uint32_t gen0 = *gen;
+    uint32_t map0 = gb->cpu.mmu->map_gen;
+    uint32_t spent = 0;
+    uint8_t i;
+
+    for (i = 0; i < n; i++, d++) {
+        gb->cpu.ins_clock.m = 0;
+
+        gb->cpu.op = d->op;
+        if (d->op == 0xCB)
+            gb->cpu.cb_op = (uint8_t)d->imm;
+        gb->cpu.imm = d->imm;
+        REG_PC += d->len;
+
+        (*d->fn)(gb);
+
+        gb->cpu.ins_clock.m += d->m;
+        gb->cpu.ins_clock.t = (gb->cpu.ins_clock.m + 3) / 4;
+
+        gb->cpu.sys_clock.m += gb->cpu.ins_clock.m;
+        gb->cpu.sys_clock.t += gb->cpu.ins_clock.t;
+        gb->cpu.ins_count++;
+
+        spent += gb->cpu.ins_clock.m;
+
+        if (spent >= left || gb->cpu.slice == 0 || *gen != gen0 ||
+                gb->cpu.mmu->map_gen != map0)
+            break;
+    }
+
+    return spent;
+}
+
+#ifdef _JIT
+/* Run b as native code, returns the M clocks spent. The native code only
+   moves registers and calls handlers. It brings sys_clock up to the start
+   of each instruction that has a handler, and of the last one it runs, so
+   handlers time events as they would in run_block; the rest of the
+   bookkeeping is done here once, for that last instruction. Only a branch
+   taken adds to ins_clock, and a branch ends its block. */
+uint32_t run_native(agb_t* gb, const dblock_t* b)
+{
+    uint32_t n = b->jit(gb);
+    const dinsn_t* d = &b->ins[n - 1];
+
+    gb->cpu.op = d->op;
+    if (d->cb)
+        gb->cpu.cb_op = (uint8_t)d->cb;
+    gb->cpu.imm = d->imm;
+
+    gb->cpu.ins_clock.m += d->m;
+    gb->cpu.ins_clock.t = (gb->cpu.ins_clock.m + 3) / 4;
+
+    gb->cpu.sys_clock.m += gb->cpu.ins_clock.m;
+    gb->cpu.sys_clock.t += gb->cpu.ins_clock.t;
+    gb->cpu.ins_count += n;
+
+    return d->pre_m + gb->cpu.ins_clock.m;
+}
+
+#ifdef _JIT_VERIFY
+int cpu_same(const cpu_t* a, const cpu_t* b)
+{
+    return a->af.w == b->af.w && a->bc.w == b->bc.w &&
+        a->de.w == b->de.w && a->hl.w == b->hl.w &&
+        a->pc == b->pc && a->sp == b->sp &&
+        a->z == b->z && a->n == b->n && a->h == b->h && a->c == b->c &&
+#ifdef _LAZY_FLAGS
+        a->lf.op == b->lf.op && a->lf.a == b->lf.a && a->lf.b == b->lf.b &&
+        a->lf.r == b->lf.r && a->lf.c == b->lf.c &&
+#endif
+        a->op == b->op && a->cb_op == b->cb_op && a->imm == b->imm &&
+        a->ime == b->ime && a->ei == b->ei && a->slice == b->slice &&
+        a->halt == b->halt && a->stop == b->stop &&
+        a->sys_clock.m == b->sys_clock.m && a->sys_clock.t == b->sys_clock.t &&
+        a->ins_clock.m == b->ins_clock.m && a->ins_clock.t == b->ins_clock.t &&
+        a->ins_count == b->ins_count;
+}
+
+int sched_same(const sched_t* a, const sched_t* b)
+{
+    uint8_t i;
+
+    if (a->len != b->len)
+        return 0;
+    for (i = 0; i < EV_MAX; i++) {
+        if (a->pos[i] != b->pos[i])
+            return 0;
+    }
+    for (i = 0; i < a->len; i++) {
+        if (a->heap[i].id != b->heap[i].id || a->heap[i].when != b->heap[i].when ||
+            a->heap[i].fn != b->heap[i].fn)
+            return 0;
+    }
+    return 1;
+}
+
+int ppu_same(const ppu_t* a, const ppu_t* b)
+{
+    return a->frames == b->frames && a->window_line == b->window_line &&
+        a->stat_line == b->stat_line && a->drawing == b->drawing && a->drawn == b->drawn &&
+        memcmp(a->fb, b->fb, sizeof(a->fb)) == 0 &&
+        memcmp(a->tiles, b->tiles, sizeof(a->tiles)) == 0;
+}
+
+/* Run b both natively and in the interpreter from the same state, and
+   abort if the two disagree on the CPU, LCD or scheduler state or on
+   what they wrote. Lines handed to a render worker can't be taken back,
+   so the native run's reach it too. */
+uint32_t verify_native(agb_t* gb, const dblock_t* b, uint32_t left)
+{
+    mmu_t* mmu = gb->cpu.mmu;
+    jit_t* j = &gb->jit;
+    cpu_t before = gb->cpu;
+    cpu_t native;
+    sched_t sched = gb->sched;
+    sched_t sched_native;
+    uint16_t nwrites, i;
+    uint32_t spent, native_spent;
+    uint8_t same;
+
+    j->mmu = *mmu;
+    j->ppu = gb->ppu;
+
+    mmu->log_len = 0;
+    mmu->logging = 1;
+    native_spent = run_native(gb, b);
+    native = gb->cpu;
+    sched_native = gb->sched;
+    j->ppu_native = gb->ppu;
+    nwrites = mmu->log_len;
+    memcpy(j->writes, mmu->log, nwrites * sizeof(mmuwrite_t));
+
+    /* Memory comes back through the journal, banks and registers with
+       the rest of the MMU */
+    mmu_rollback(mmu);
+    *mmu = j->mmu;
+    gb->cpu = before;
+    gb->sched = sched;
+    gb->ppu = j->ppu;
+
+    mmu->log_len = 0;
+    mmu->logging = 1;
+    spent = run_block(gb, b->ins, b->count, left);
+    mmu->logging = 0;
+
+    same = spent == native_spent && cpu_same(&gb->cpu, &native) &&
+        sched_same(&gb->sched, &sched_native) && ppu_same(&gb->ppu, &j->ppu_native) &&
+        nwrites == mmu->log_len;
+    for (i = 0; same && i < nwrites; i++)
+        same = j->writes[i].addr == mmu->log[i].addr && j->writes[i].old == mmu->log[i].old &&
+            j->writes[i].val == mmu->log[i].val;
+
+    if (!same) {
+        fprintf(stderr, "jit: block $%x (bank %u) differs from the interpreter\n",
+            b->pc, b->bank);
+        abort();
+    }
+
+    return spent;
+}
+#endif
+#endif
+#endif
+
+/* M clocks until the next scheduled event, at most left */
+uint32_t next_event(agb_t* gb, uint32_t left)
+{
+    uint32_t until = sched_until(&gb->sched, gb->cpu.sys_clock.m);
+
+    return until < left ? until : left;
+}
+
+/* Let the clock run for left M clocks with the CPU halted or stopped, in
+   whole machine cycles. Returns the M clocks spent. */
+uint32_t cpu_idle(agb_t* gb, uint32_t left)
+{
+    uint32_t m = (left + 3) & ~(uint32_t)3;
+
+    gb->cpu.ins_clock.m = m;
+    gb->cpu.ins_clock.t = m / 4;
+
+    gb->cpu.sys_clock.m += gb->cpu.ins_clock.m;
+    gb->cpu.sys_clock.t += gb->cpu.ins_clock.t;
+
+    return m;
+}
+
+#ifdef _DECODE_CACHE
+/* What a pass of a spinning block is checked against: the registers it
+   has to leave as they were, and the counters to skip ahead by */
+typedef struct {
+    cpureg_t af, bc, de, hl;
+    uint16_t sp;
+    uint8_t z, n, h, c;
+#ifdef _LAZY_FLAGS
+    lazyflags_t lf;
+#endif
+    uint32_t t;         /* sys_clock.t */
+    uint32_t ins_count;
+} spin_t;
+
+void spin_save(agb_t* gb, spin_t* s)
+{
+    s->af = gb->cpu.af;
+    s->bc = gb->cpu.bc;
+    s->de = gb->cpu.de;
+    s->hl = gb->cpu.hl;
+    s->sp = gb->cpu.sp;
+    s->z = gb->cpu.z;
+    s->n = gb->cpu.n;
+    s->h = gb->cpu.h;
+    s->c = gb->cpu.c;
+#ifdef _LAZY_FLAGS
+    s->lf = gb->cpu.lf;
+#endif
+    s->t = gb->cpu.sys_clock.t;
+    s->ins_count = gb->cpu.ins_count;
+}
+
+/* Whether the registers are back to what they were in s */
+uint8_t cpu_spun(agb_t* gb, const spin_t* s)
+{
+    return gb->cpu.af.w == s->af.w && gb->cpu.bc.w == s->bc.w &&
+        gb->cpu.de.w == s->de.w && gb->cpu.hl.w == s->hl.w &&
+        gb->cpu.sp == s->sp &&
+#ifdef _LAZY_FLAGS
+        gb->cpu.lf.op == s->lf.op && gb->cpu.lf.a == s->lf.a && gb->cpu.lf.b == s->lf.b &&
+        gb->cpu.lf.r == s->lf.r && gb->cpu.lf.c == s->lf.c &&
+#endif
+        gb->cpu.z == s->z && gb->cpu.n == s->n && gb->cpu.h == s->h && gb->cpu.c == s->c;
+}
+
+/* Fast-forward a spinning block by as many passes of m M clocks as fit
+   in left (> 0), returns the M clocks skipped. t and i are the T clocks
+   and instructions of one pass. Nothing else can change memory before
+   left runs out, as that is where the next event is. */
+uint32_t spin_skip(agb_t* gb, uint32_t m, uint32_t t, uint32_t i, uint32_t left)
+{
+    uint32_t n = (left - 1) / m;
+
+    gb->cpu.sys_clock.m += n * m;
+    gb->cpu.sys_clock.t += n * t;
+    gb->cpu.ins_count += n * i;
+
+    return n * m;
+}
+#endif
 
 /* Executive functions */
-void cpu_reset(void)
+void cpu_reset(agb_t* gb)
 {
     FLAG_Z = 1;
     FLAG_N = 0;
     FLAG_H = 1;
     FLAG_C = 1;
+#ifdef _LAZY_FLAGS
+    gb->cpu.lf.op = LF_NONE;
+#endif
+#ifdef _ALU_TABLES
+    if (!alu_ready)
+        alu_init(gb);
+#endif
 
     REG_BC = 0x0013;
     REG_DE = 0x00D8;
@@ -1235,61 +2153,348 @@ void cpu_reset(void)
 
     REG_A = 0x01;
 
-    cpu.op = 0;
+    gb->cpu.op = 0;
+
+    gb->cpu.ime = 0;
+    gb->cpu.ei = 0;
+    gb->cpu.halt = 0;
+    gb->cpu.stop = 0;
+    gb->cpu.slice = 0;
+    if (gb->cpu.mmu)
+        gb->cpu.mmu->gb = gb;
+
+    gb->cpu.sys_clock.m = 0;
+    gb->cpu.sys_clock.t = 0;
+    gb->cpu.ins_clock.m = 0;
+    gb->cpu.ins_clock.t = 0;
+    gb->cpu.ins_count = 0;
 
-    cpu.sys_clock.m = 0;
-    cpu.sys_clock.t = 0;
-    cpu.ins_clock.m = 0;
-    cpu.ins_clock.t = 0;
+    sched_reset(&gb->sched);
+
+#ifdef _DECODE_CACHE
+    dcache_flush(gb);
+#endif
 }
 
-int cpu_run(uint32_t cycles)
+/* Run the CPU for at least cycles M clocks, with nothing scheduled to
+   happen before they are up. Stops early, after the instruction, if that
+   zeroes gb->cpu.slice. Returns the M clocks spent. */
+#if defined(_DECODE_CACHE)
+uint32_t cpu_exec(agb_t* gb, uint32_t cycles)
 {
     uint32_t total = 0;
+    uint32_t spent;
+    uint16_t bank;
+    dblock_t* b;
+    dinsn_t single;
+    spin_t before;
+
+    gb->cpu.slice = cycles;
+
+    while (total < gb->cpu.slice) {
+        if (gb->cpu.halt || gb->cpu.stop) {
+            total += cpu_idle(gb, gb->cpu.slice - total);
+            continue;
+        }
 
-    while (total < cycles) {
-        cpu.ins_clock.m = 0;
+        /* During OAM DMA code outside page 0xFF reads as 0xFF, which
+           the cached blocks don't know about */
+        if (gb->cpu.mmu->dma_lock && REG_PC < 0xFF00) {
+            decode(gb, REG_PC, &single);
+            total += run_block(gb, &single, 1, gb->cpu.slice - total);
+            continue;
+        }
+
+        bank = block_bank(gb, REG_PC);
+        b = &gb->dcache[(REG_PC ^ (bank << 6)) & (DCACHE_SIZE - 1)];
 
-        /* TODO: Interrupts */
+        if (b->count == 0 || b->pc != REG_PC || b->bank != bank || b->gen != gb->cpu.mmu->page_gen[REG_PC >> 8])
+            decode_block(gb, b, REG_PC, bank);
 
-        cpu.op = read_8(cpu.mmu, REG_PC++);
+        if (b->count == 0) {
+            decode(gb, REG_PC, &single);
+            total += run_block(gb, &single, 1, gb->cpu.slice - total);
+            continue;
+        }
+
+        /* Small enough to take for every block, spinning or not */
+        spin_save(gb, &before);
 
-        (*ops[cpu.op])();
+#ifdef _JIT
+        /* Code in a recycled buffer is gone, count the block from scratch */
+        if (b->epoch != gb->jit.epoch) {
+            b->epoch = gb->jit.epoch;
+            b->hits = 0;
+            b->jit = NULL;
+        }
 
-        if (cpu.op != 0xCB) {
-            cpu.ins_clock.m += timings_m[cpu.op];
-            cpu.ins_clock.t = timings_t[cpu.op];
+        /* Native code runs the whole block, so it may only be used if the
+           interpreter would not stop before the last instruction */
+        if (b->jit && b->ins[b->count - 1].pre_m < gb->cpu.slice - total) {
+#ifdef _JIT_VERIFY
+            spent = verify_native(gb, b, gb->cpu.slice - total);
+#else
+            spent = run_native(gb, b);
+#endif
         } else {
-            cpu.ins_clock.m += cb_timings_m[cpu.cb_op];
+            if (b->hits < JIT_THRESHOLD && ++b->hits == JIT_THRESHOLD) {
+                b->jit = jit_compile(gb, b);
+                b->epoch = gb->jit.epoch;
+            }
+
+            spent = run_block(gb, b->ins, b->count, gb->cpu.slice - total);
+        }
+#else
+        spent = run_block(gb, b->ins, b->count, gb->cpu.slice - total);
+#endif
+        total += spent;
+
+        /* Idle loop, skip ahead to when it can end */
+        if (b->spin && total < gb->cpu.slice && REG_PC == b->pc && cpu_spun(gb, &before))
+            total += spin_skip(gb, spent, gb->cpu.sys_clock.t - before.t,
+                gb->cpu.ins_count - before.ins_count, gb->cpu.slice - total);
+    }
+
+    return total;
+}
+#elif !defined(_THREADED)
+uint32_t cpu_exec(agb_t* gb, uint32_t cycles)
+{
+    uint32_t total = 0;
+
+    gb->cpu.slice = cycles;
+
+    while (total < gb->cpu.slice) {
+        gb->cpu.ins_clock.m = 0;
+
+        if (gb->cpu.halt || gb->cpu.stop) {
+            total += cpu_idle(gb, gb->cpu.slice - total);
+            continue;
+        }
+
+        gb->cpu.op = read_8(gb->cpu.mmu, REG_PC++);
+
+        (*ops[gb->cpu.op])(gb);
+
+        if (gb->cpu.op != 0xCB)
+            gb->cpu.ins_clock.m += timings_m[gb->cpu.op];
+        else
+            gb->cpu.ins_clock.m += cb_timings_m[gb->cpu.cb_op];
+
+        gb->cpu.ins_clock.t = (gb->cpu.ins_clock.m + 3) / 4;
+
+        gb->cpu.sys_clock.m += gb->cpu.ins_clock.m;
+        gb->cpu.sys_clock.t += gb->cpu.ins_clock.t;
+        gb->cpu.ins_count++;
+
+        total += gb->cpu.ins_clock.m;
+    }
+
+    return total;
+}
+#else
+/*
+ * Threaded core. Every opcode gets its own copy of the dispatch code, and
+ * since the table index is a constant at each copy, the compiler turns the
+ * ops[]/cb_ops[] call into a direct (usually inlined) call and the timing
+ * lookup into an immediate. GNU compilers jump between handlers with
+ * computed gotos; anything else gets one big switch.
+ */
+#define RETIRE(clk)                                         \
+    gb->cpu.ins_clock.m += (clk);                           \
+    gb->cpu.ins_clock.t = (gb->cpu.ins_clock.m + 3) / 4;    \
+    gb->cpu.sys_clock.m += gb->cpu.ins_clock.m;             \
+    gb->cpu.sys_clock.t += gb->cpu.ins_clock.t;             \
+    gb->cpu.ins_count++;                                    \
+    total += gb->cpu.ins_clock.m;                           \
+    if (total >= gb->cpu.slice)                             \
+        return total
+
+#ifdef __GNUC__
+#define OP_LABEL(n) &&op_##n,
+#define CB_LABEL(n) &&cb_##n,
+#define OP_CASE(n) op_##n:
+#define CB_CASE(n) cb_##n:
+#define DISPATCH()                                          \
+    gb->cpu.ins_clock.m = 0;                                \
+    gb->cpu.op = read_8(gb->cpu.mmu, REG_PC++);             \
+    goto *op_labels[gb->cpu.op]
+#define IDLE(n)                                             \
+    if ((0x##n == 0x10 || 0x##n == 0x76) &&                 \
+            (gb->cpu.halt || gb->cpu.stop))                 \
+        goto idle;
+#define OP_PREFIX(n)                                        \
+    OP_CASE(n)                                              \
+    gb->cpu.cb_op = read_8(gb->cpu.mmu, REG_PC++);          \
+    goto *cb_labels[gb->cpu.cb_op];
+#else
+#define OP_CASE(n) case 0x##n:
+#define CB_CASE(n) case 0x##n:
+#define DISPATCH() continue
+#define IDLE(n)
+#define OP_PREFIX(n)                                        \
+    OP_CASE(n)                                              \
+    gb->cpu.cb_op = read_8(gb->cpu.mmu, REG_PC++);          \
+    switch (gb->cpu.cb_op) {                                \
+    CB_OPS_ALL(CB_BODY)                                     \
+    }
+#endif
+
+#define OP_BODY(n)                                          \
+    OP_CASE(n)                                              \
+    (*ops[0x##n])(gb);                                      \
+    RETIRE(timings_m[0x##n]);                               \
+    IDLE(n)                                                 \
+    DISPATCH();
+
+#define CB_BODY(n)                                          \
+    CB_CASE(n)                                              \
+    (*cb_ops[0x##n])(gb);                                   \
+    RETIRE(cb_timings_m[0x##n]);                            \
+    DISPATCH();
+
+uint32_t cpu_exec(agb_t* gb, uint32_t cycles)
+{
+    uint32_t total = 0;
+
+#ifdef __GNUC__
+    static void* const op_labels[256] = { OPS_ALL(OP_LABEL, OP_LABEL) };
+    static void* const cb_labels[256] = { CB_OPS_ALL(CB_LABEL) };
+
+    gb->cpu.slice = cycles;
+    if (cycles == 0)
+        return 0;
+
+    if (gb->cpu.halt || gb->cpu.stop)
+        goto idle;
+
+    DISPATCH();
+
+    OPS_ALL(OP_BODY, OP_PREFIX)
+    CB_OPS_ALL(CB_BODY)
+
+idle:
+    while (gb->cpu.halt || gb->cpu.stop) {
+        total += cpu_idle(gb, gb->cpu.slice - total);
+        if (total >= gb->cpu.slice)
+            return total;
+    }
+
+    DISPATCH();
+#else
+    gb->cpu.slice = cycles;
+
+    while (total < gb->cpu.slice) {
+        gb->cpu.ins_clock.m = 0;
+
+        if (gb->cpu.halt || gb->cpu.stop) {
+            total += cpu_idle(gb, gb->cpu.slice - total);
+            continue;
         }
-        /* TODO: ^ replace with:
-            cpu.ins_clock.t = CEIL(cpu.ins_clock.m / 4.0)
-        */
-        cpu.sys_clock.m += cpu.ins_clock.m;
-        cpu.sys_clock.t += cpu.ins_clock.t;
 
-        total += cpu.ins_clock.m;
+        gb->cpu.op = read_8(gb->cpu.mmu, REG_PC++);
+
+        switch (gb->cpu.op) {
+        OPS_ALL(OP_BODY, OP_PREFIX)
+        }
+    }
+#endif
+
+    return total;
+}
+#endif
+
+/* Wake from HALT for a pending interrupt and, if interrupts are enabled,
+   jump to the handler of the highest priority one. Returns the M clocks
+   spent. */
+uint32_t cpu_interrupt(agb_t* gb)
+{
+    mmu_t* mmu = gb->cpu.mmu;
+    uint8_t pending = mmu->ie & mmu->iflag & 0x1F;
+    uint8_t bit = 0;
+
+    gb->cpu.halt = 0;
+
+    if (!gb->cpu.ime)
+        return 0;
+
+    while (!(pending & (1 << bit)))
+        bit++;
+
+    mmu->iflag &= ~(1 << bit);
+    gb->cpu.ime = 0;
+
+    push(gb, REG_PC);
+    REG_PC = 0x40 + bit * 8;
+
+    gb->cpu.ins_clock.m = 20;
+    gb->cpu.ins_clock.t = 5;
+
+    gb->cpu.sys_clock.m += gb->cpu.ins_clock.m;
+    gb->cpu.sys_clock.t += gb->cpu.ins_clock.t;
+
+    return gb->cpu.ins_clock.m;
+}
+
+void cpu_irq(agb_t* gb, uint8_t irq)
+{
+    gb->cpu.mmu->iflag |= irq;
+    END_SLICE();
+}
+
+/*
+ * Interrupts are only looked at between slices. Events raise them when a
+ * slice is over anyway, and the instructions that can make one pending
+ * (EI, RETI, HALT, writes to IE and IF) end their slice early, so the
+ * cores never test for them per instruction.
+ */
+int cpu_run(agb_t* gb, uint32_t cycles)
+{
+    uint32_t total = 0;
+
+    while (total < cycles) {
+        sched_run(gb, &gb->sched, gb->cpu.sys_clock.m);
+
+        /* EI takes effect after the instruction that follows it */
+        if (gb->cpu.ei) {
+            gb->cpu.ei = 0;
+            gb->cpu.ime = 1;
+            total += cpu_exec(gb, 1);
+            continue;
+        }
+
+        if ((gb->cpu.ime || gb->cpu.halt) &&
+                (gb->cpu.mmu->ie & gb->cpu.mmu->iflag & 0x1F)) {
+            total += cpu_interrupt(gb);
+            continue;
+        }
+
+        total += cpu_exec(gb, next_event(gb, cycles - total));
     }
 
     return 0;
 }
 
 /* Save states */
-void save_state(void)
+void save_state(agb_t* gb)
 {
+    (void)gb;
+
     /* TODO */
     /* Save CPU state */
     /* Write to disk */
 }
 
-void load_state(void)
+void load_state(agb_t* gb)
 {
-    cpu = save_states[curr_save_slot];
+    gb->cpu = gb->save_states[gb->curr_save_slot];
 }
 
 /* Debug */
-void print_cpu(void)
+void print_cpu(agb_t* gb)
 {
+    SYNC_FLAGS();
+
     printf("AF     :  $%x\n", REG_AF);
     printf("BC     :  $%x\n", REG_BC);
     printf("DE     :  $%x\n", REG_DE);
@@ -1303,25 +2508,29 @@ void print_cpu(void)
     printf("L      :  $%hx\n", REG_L);
     printf("PC     :  $%x\n", REG_PC);
     printf("SP     :  $%x\n", REG_SP);
-    printf("OP     :  $%hx\n", cpu.op);
-    printf("CBOP   :  $%hx\n", cpu.cb_op);
+    printf("OP     :  $%hx\n", gb->cpu.op);
+    printf("CBOP   :  $%hx\n", gb->cpu.cb_op);
     printf("FLAGZ  :  $%hx\n", FLAG_Z);
     printf("FLAGN  :  $%hx\n", FLAG_N);
     printf("FLAGH  :  $%hx\n", FLAG_H);
     printf("FLAGC  :  $%hx\n", FLAG_C);
-    printf("IME    :  $%hx\n", cpu.ime);
-    printf("HALT   :  $%hx\n", cpu.halt);
-    printf("STOP   :  $%hx\n", cpu.stop);
-    printf("SCLOCKM:  $%hx\n", cpu.sys_clock.m);
-    printf("SCLOCKT:  $%hx\n", cpu.sys_clock.t);
-    printf("ICLOCKM:  $%hx\n", cpu.ins_clock.m);
-    printf("ICLOCKT:  $%hx\n", cpu.ins_clock.t);
+    printf("IME    :  $%hx\n", gb->cpu.ime);
+    printf("HALT   :  $%hx\n", gb->cpu.halt);
+    printf("STOP   :  $%hx\n", gb->cpu.stop);
+    printf("SCLOCKM:  $%hx\n", gb->cpu.sys_clock.m);
+    printf("SCLOCKT:  $%hx\n", gb->cpu.sys_clock.t);
+    printf("ICLOCKM:  $%hx\n", gb->cpu.ins_clock.m);
+    printf("ICLOCKT:  $%hx\n", gb->cpu.ins_clock.t);
 }
 
+#if !defined(_BATCH) && !defined(_SIMD_TEST)
 int main(void)
 {
 #ifdef _DEBUG
 
+    static agb_t machine;
+    agb_t* gb = &machine;
+
     uint8_t prg[5] = {
         0x3E, 0x01, 0x0E, 0x01, 0x81
     };
@@ -1329,12 +2538,13 @@ int main(void)
     mmu_t mem;
     mem.ram = prg;
 
-    cpu.mmu = &mem;
+    gb->cpu.mmu = &mem;
 
-    cpu_run(20);
-    print_cpu();
+    cpu_run(gb, 20);
+    print_cpu(gb);
 
 #endif
     return 0;
 }
+#endif
 
@@ -34,36 +34,48 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <stdint.h>
 #include "mmu.h"
 
-#define REG_AF cpu.af.w
-#define REG_BC cpu.bc.w
-#define REG_DE cpu.de.w
-#define REG_HL cpu.hl.w
-#define REG_PC cpu.pc
-#define REG_SP cpu.sp
-
-#define FLAG_Z cpu.z
-#define FLAG_N cpu.n
-#define FLAG_H cpu.h
-#define FLAG_C cpu.c
+/* Emulator context, see agb.h */
+typedef struct agb agb_t;
+
+#if defined(_JIT_VERIFY) && !defined(_JIT)
+#error "_JIT_VERIFY needs _JIT"
+#endif
+
+#if defined(_JIT) && !defined(_DECODE_CACHE)
+#error "_JIT needs _DECODE_CACHE"
+#endif
+
+/* Registers and flags of the context in scope as gb */
+#define REG_AF gb->cpu.af.w
+#define REG_BC gb->cpu.bc.w
+#define REG_DE gb->cpu.de.w
+#define REG_HL gb->cpu.hl.w
+#define REG_PC gb->cpu.pc
+#define REG_SP gb->cpu.sp
+
+#define FLAG_Z gb->cpu.z
+#define FLAG_N gb->cpu.n
+#define FLAG_H gb->cpu.h
+#define FLAG_C gb->cpu.c
 
 #ifdef _BIG_ENDIAN
-#define REG_A cpu.af.b.h
-#define REG_F cpu.af.b.l
-#define REG_B cpu.bc.b.h
-#define REG_C cpu.bc.b.l
-#define REG_D cpu.bc.b.h
-#define REG_E cpu.bc.b.l
-#define REG_H cpu.bc.b.h
-#define REG_L cpu.bc.b.l
+#define REG_A gb->cpu.af.b.h
+#define REG_F gb->cpu.af.b.l
+#define REG_B gb->cpu.bc.b.h
+#define REG_C gb->cpu.bc.b.l
+#define REG_D gb->cpu.bc.b.h
+#define REG_E gb->cpu.bc.b.l
+#define REG_H gb->cpu.bc.b.h
+#define REG_L gb->cpu.bc.b.l
 #else
-#define REG_A cpu.af.b.l
-#define REG_F cpu.af.b.h
-#define REG_B cpu.bc.b.l
-#define REG_C cpu.bc.b.h
-#define REG_D cpu.bc.b.l
-#define REG_E cpu.bc.b.h
-#define REG_H cpu.bc.b.l
-#define REG_L cpu.bc.b.h
+#define REG_A gb->cpu.af.b.l
+#define REG_F gb->cpu.af.b.h
+#define REG_B gb->cpu.bc.b.l
+#define REG_C gb->cpu.bc.b.h
+#define REG_D gb->cpu.bc.b.l
+#define REG_E gb->cpu.bc.b.h
+#define REG_H gb->cpu.bc.b.l
+#define REG_L gb->cpu.bc.b.h
 #endif
 
 /* Double 8-bit registers */
@@ -80,27 +92,96 @@ typedef struct {
     uint32_t t; /* Clock periods */
 } cpuclock_t;
 
+#ifdef _LAZY_FLAGS
+/* Last flag-setting operation, see flags_sync() */
+typedef struct {
+    uint8_t op;   /* Operation kind */
+    uint8_t a, b; /* Operands */
+    uint8_t r;    /* Result */
+    uint8_t c;    /* Carry in/out */
+} lazyflags_t;
+#endif
+
 typedef struct {
     mmu_t* mmu;              /* Memory */
     cpuclock_t sys_clock;    /* Master clock */
     cpuclock_t ins_clock;    /* Last instruction clock */
+    uint32_t ins_count;      /* Instructions run, wraps around */
+    uint32_t slice;          /* M clocks cpu_exec() may run, 0 to stop early */
     cpureg_t af, bc, de, hl; /* 8-bit registers */
     uint16_t pc, sp;         /* 16-bit registers */
     uint8_t z, n, h, c;      /* Status flags */
+#ifdef _LAZY_FLAGS
+    lazyflags_t lf;          /* Pending flag computation */
+#endif
     uint8_t op;              /* Current opcode */
     uint8_t cb_op;           /* Current opcode (0xCB prefix) */
     uint8_t ime;             /* Interrupts enabled */
+    uint8_t ei;              /* EI ran, ime goes on after one more instruction */
     uint8_t halt;            /* HALT status */
     uint8_t stop;            /* STOP status */
+#ifdef _DECODE_CACHE
+    uint16_t imm;            /* Predecoded immediate operand */
+#endif
 } cpu_t;
 
+#ifdef _DECODE_CACHE
+#define DCACHE_SIZE 1024 /* Blocks, must be a power of two */
+#define DBLOCK_MAX 16    /* Instructions per block */
+
+/* Decoded instruction */
+typedef struct {
+    void (*fn)(agb_t* gb); /* Handler */
+    uint16_t imm;   /* Immediate operand, or the 0xCB opcode */
+    uint16_t pre_m; /* M clocks of the instructions before it in the block */
+    uint16_t pre_t; /* T clocks of the instructions before it in the block */
+    uint16_t cb;    /* 0x100 | last 0xCB opcode up to here, 0 if none */
+    uint8_t op;     /* Opcode */
+    uint8_t len;    /* Opcode bytes */
+    uint8_t size;   /* Instruction bytes */
+    uint8_t m;      /* M clocks, not counting branches taken */
+} dinsn_t;
+
+/* Decoded block */
+typedef struct {
+    uint16_t pc;    /* Address of the first instruction */
+    uint16_t bank;  /* ROM bank it was decoded from */
+    uint32_t gen;   /* Write generation of its page */
+    uint8_t count;  /* Instructions, 0 if the slot is empty */
+    uint8_t spin;   /* Read-only loop back to pc, see block_spins() */
+#ifdef _JIT
+    uint8_t hits;   /* Interpreter runs since epoch, up to JIT_THRESHOLD */
+    uint32_t epoch; /* Code buffer generation of jit */
+    uint32_t (*jit)(agb_t* gb); /* Native code */
+#endif
+    dinsn_t ins[DBLOCK_MAX];
+} dblock_t;
+#endif
+
+/* Interrupt sources, bits of IE and IF */
+#define IRQ_VBLANK 0x01
+#define IRQ_LCD    0x02
+#define IRQ_TIMER  0x04
+#define IRQ_SERIAL 0x08
+#define IRQ_JOYPAD 0x10
+
 /* Executive functions */
-void cpu_reset(void);
-int cpu_run(uint32_t cycles);
+void cpu_reset(agb_t* gb);
+int cpu_run(agb_t* gb, uint32_t cycles);
+
+/* Request an interrupt, serviced before the next instruction */
+void cpu_irq(agb_t* gb, uint8_t irq);
+
+#ifdef _ALU_TABLES
+/* Build the ALU tables and check them, returns -1 on a mismatch, in
+   which case the reference helpers are used instead. The check borrows
+   gb's registers. cpu_reset() calls this the first time it runs. */
+int alu_init(agb_t* gb);
+#endif
 
 /* Save states */
-void save_state(void);
-void load_state(void);
+void save_state(agb_t* gb);
+void load_state(agb_t* gb);
 
 #endif
 
@@ -0,0 +1,127 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "event.h"
+
+/* Whether a is due before b */
+#define BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+void sched_reset(sched_t* s)
+{
+    uint8_t i;
+
+    s->len = 0;
+    for (i = 0; i < EV_MAX; i++)
+        s->pos[i] = -1;
+}
+
+/* Put e at heap index i and update its position */
+void sched_put(sched_t* s, uint8_t i, event_t e)
+{
+    s->heap[i] = e;
+    s->pos[e.id] = (int8_t)i;
+}
+
+/* Move the event at i up or down until the heap is ordered again */
+void sched_fix(sched_t* s, uint8_t i)
+{
+    event_t e = s->heap[i];
+    uint8_t child;
+
+    while (i > 0 && BEFORE(e.when, s->heap[(i - 1) / 2].when)) {
+        sched_put(s, i, s->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= s->len)
+            break;
+        if (child + 1 < s->len && BEFORE(s->heap[child + 1].when, s->heap[child].when))
+            child++;
+        if (!BEFORE(s->heap[child].when, e.when))
+            break;
+        sched_put(s, i, s->heap[child]);
+        i = child;
+    }
+
+    sched_put(s, i, e);
+}
+
+void sched_add(sched_t* s, uint8_t id, uint32_t when, event_fn_t fn)
+{
+    event_t e;
+    uint8_t i;
+
+    e.when = when;
+    e.fn = fn;
+    e.id = id;
+
+    if (s->pos[id] < 0)
+        i = s->len++;
+    else
+        i = (uint8_t)s->pos[id];
+
+    s->heap[i] = e;
+    sched_fix(s, i);
+}
+
+void sched_cancel(sched_t* s, uint8_t id)
+{
+    uint8_t i;
+
+    if (s->pos[id] < 0)
+        return;
+
+    i = (uint8_t)s->pos[id];
+    s->pos[id] = -1;
+
+    if (i != --s->len) {
+        s->heap[i] = s->heap[s->len];
+        sched_fix(s, i);
+    }
+}
+
+uint32_t sched_until(sched_t* s, uint32_t now)
+{
+    if (s->len == 0)
+        return 0xFFFFFFFF;
+    if (!BEFORE(now, s->heap[0].when))
+        return 0;
+    return s->heap[0].when - now;
+}
+
+void sched_run(struct agb* gb, sched_t* s, uint32_t now)
+{
+    event_t e;
+
+    /* Handlers may add events, including ones that are due already */
+    while (s->len > 0 && !BEFORE(now, s->heap[0].when)) {
+        e = s->heap[0];
+        sched_cancel(s, e.id);
+        e.fn(gb, e.when);
+    }
+}
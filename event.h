@@ -0,0 +1,83 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef _EVENT_H
+#define _EVENT_H
+
+#include <stdint.h>
+
+struct agb;
+
+/*
+ * Event scheduler. Every component keeps at most one pending event, due at
+ * an absolute sys_clock.m time, in a min-heap ordered by that time. The
+ * CPU runs uninterrupted up to the earliest one (see cpu_run), and a
+ * component is otherwise only brought up to date when the CPU touches its
+ * registers. Times may wrap; they are compared as signed differences.
+ */
+
+/* Event sources */
+enum {
+    EV_TIMER,
+    EV_LCD,
+    EV_SERIAL,
+    EV_SOUND,
+    EV_DMA,
+    EV_MAX
+};
+
+/* Called with the time the event was due, which may be in the past */
+typedef void (*event_fn_t)(struct agb* gb, uint32_t when);
+
+typedef struct {
+    uint32_t when;   /* Due time */
+    event_fn_t fn;   /* Handler */
+    uint8_t id;      /* Event source */
+} event_t;
+
+typedef struct {
+    event_t heap[EV_MAX];  /* Pending events, earliest first */
+    uint8_t len;
+    int8_t pos[EV_MAX];    /* Heap index of each source, -1 if idle */
+} sched_t;
+
+/* Drop all pending events */
+void sched_reset(sched_t* s);
+
+/* Schedule the event for source id, replacing a pending one */
+void sched_add(sched_t* s, uint8_t id, uint32_t when, event_fn_t fn);
+
+/* Drop the pending event for source id, if any */
+void sched_cancel(sched_t* s, uint8_t id);
+
+/* Clocks from now until the next event, 0 if one is due and
+   0xFFFFFFFF if none is pending */
+uint32_t sched_until(sched_t* s, uint32_t now);
+
+/* Fire every event due at or before now, in order, passing them gb */
+void sched_run(struct agb* gb, sched_t* s, uint32_t now);
+
+#endif
@@ -0,0 +1,427 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <string.h>
+#include "inflate.h"
+
+#define HUFF_FAST 10  /* Bits resolved by one table lookup */
+#define HUFF_MAX  15  /* Longest code */
+
+/*
+ * Canonical Huffman code. Codes up to HUFF_FAST bits long are decoded
+ * with one lookup in fast, indexed by the next bits of input; longer ones
+ * are walked a bit at a time through count and symbol.
+ */
+typedef struct {
+    uint16_t fast[1 << HUFF_FAST]; /* Length << 9 | symbol, 0 if longer */
+    uint16_t count[HUFF_MAX + 1];  /* Codes of each length */
+    uint16_t symbol[288];          /* Symbols in code order */
+} huff_t;
+
+/* Input bits, least significant first */
+typedef struct {
+    const uint8_t* in;
+    const uint8_t* end;
+    uint64_t buf;
+    int count; /* Valid bits in buf */
+} bits_t;
+
+const uint16_t len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+const uint8_t len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* Order the code length code lengths are sent in */
+const uint8_t clen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+const uint32_t crc32_table[256] = {
+    0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F,
+    0xE963A535, 0x9E6495A3, 0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
+    0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91, 0x1DB71064, 0x6AB020F2,
+    0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+    0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9,
+    0xFA0F3D63, 0x8D080DF5, 0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
+    0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B, 0x35B5A8FA, 0x42B2986C,
+    0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+    0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423,
+    0xCFBA9599, 0xB8BDA50F, 0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
+    0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D, 0x76DC4190, 0x01DB7106,
+    0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+    0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D,
+    0x91646C97, 0xE6635C01, 0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
+    0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457, 0x65B0D9C6, 0x12B7E950,
+    0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+    0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7,
+    0xA4D1C46D, 0xD3D6F4FB, 0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
+    0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9, 0x5005713C, 0x270241AA,
+    0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+    0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81,
+    0xB7BD5C3B, 0xC0BA6CAD, 0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
+    0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683, 0xE3630B12, 0x94643B84,
+    0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+    0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB,
+    0x196C3671, 0x6E6B06E7, 0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
+    0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5, 0xD6D6A3E8, 0xA1D1937E,
+    0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+    0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55,
+    0x316E8EEF, 0x4669BE79, 0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
+    0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F, 0xC5BA3BBE, 0xB2BD0B28,
+    0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+    0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F,
+    0x72076785, 0x05005713, 0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
+    0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21, 0x86D3D2D4, 0xF1D4E242,
+    0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+    0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69,
+    0x616BFFD3, 0x166CCF45, 0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
+    0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB, 0xAED16A4A, 0xD9D65ADC,
+    0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+    0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693,
+    0x54DE5729, 0x23D967BF, 0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
+    0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D,
+};
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t len)
+{
+    crc = ~crc;
+    while (len--)
+        crc = crc32_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/* Top the bit buffer up to at least 57 bits, or whatever input is left */
+void bits_fill(bits_t* b)
+{
+    while (b->count <= 56 && b->in < b->end) {
+        b->buf |= (uint64_t)*b->in++ << b->count;
+        b->count += 8;
+    }
+}
+
+/* Take n (<= 32) bits, -1 if the input ran out */
+long bits_get(bits_t* b, int n)
+{
+    long v;
+
+    if (b->count < n) {
+        bits_fill(b);
+        if (b->count < n)
+            return -1;
+    }
+
+    v = (long)(b->buf & (((uint64_t)1 << n) - 1));
+    b->buf >>= n;
+    b->count -= n;
+
+    return v;
+}
+
+/* Build h from the code length of each of n symbols. Returns -1 if the
+   lengths describe more codes than there is room for; incomplete codes
+   are let through, as DEFLATE allows a single distance code. */
+int huff_build(huff_t* h, const uint8_t* lengths, int n)
+{
+    uint16_t offs[HUFF_MAX + 2];
+    int left = 1;
+    int code = 0;
+    int len, sym, i, j, rev;
+
+    memset(h->count, 0, sizeof(h->count));
+    for (sym = 0; sym < n; sym++)
+        h->count[lengths[sym]]++;
+    h->count[0] = 0;
+
+    for (len = 1; len <= HUFF_MAX; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0)
+            return -1;
+    }
+
+    offs[1] = 0;
+    for (len = 1; len <= HUFF_MAX; len++)
+        offs[len + 1] = offs[len] + h->count[len];
+    for (sym = 0; sym < n; sym++)
+        if (lengths[sym])
+            h->symbol[offs[lengths[sym]]++] = (uint16_t)sym;
+
+    /* Fill in the table for the short codes, bit-reversed as they come
+       off the input least significant bit first */
+    memset(h->fast, 0, sizeof(h->fast));
+    sym = 0;
+    for (len = 1; len <= HUFF_MAX; len++) {
+        for (i = 0; i < h->count[len]; i++, sym++, code++) {
+            if (len > HUFF_FAST)
+                continue;
+            rev = 0;
+            for (j = 0; j < len; j++)
+                rev |= ((code >> j) & 1) << (len - 1 - j);
+            for (; rev < (1 << HUFF_FAST); rev += 1 << len)
+                h->fast[rev] = (uint16_t)(len << 9 | h->symbol[sym]);
+        }
+        code <<= 1;
+    }
+
+    return 0;
+}
+
+/* Next symbol of code h, -1 if the input ran out or holds no such code */
+int huff_decode(bits_t* b, const huff_t* h)
+{
+    int code = 0, first = 0, index = 0;
+    int len, count, e;
+
+    if (b->count < HUFF_MAX)
+        bits_fill(b);
+
+    e = h->fast[b->buf & ((1 << HUFF_FAST) - 1)];
+    if (e) {
+        if ((e >> 9) > b->count)
+            return -1;
+        b->buf >>= e >> 9;
+        b->count -= e >> 9;
+        return e & 0x1FF;
+    }
+
+    for (len = 1; len <= HUFF_MAX && len <= b->count; len++) {
+        code |= (int)(b->buf >> (len - 1)) & 1;
+        count = h->count[len];
+        if (code - count < first) {
+            b->buf >>= len;
+            b->count -= len;
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+
+    return -1;
+}
+
+/* Read the code lengths of a dynamic block and build its codes */
+int inflate_tables(bits_t* b, huff_t* lit, huff_t* dist)
+{
+    uint8_t lengths[288 + 32];
+    long nlit, ndist, nclen, v, rep;
+    int i, sym;
+
+    nlit = bits_get(b, 5);
+    ndist = bits_get(b, 5);
+    nclen = bits_get(b, 4);
+    if (nclen < 0)
+        return -1;
+    nlit += 257;
+    ndist += 1;
+    nclen += 4;
+    if (nlit > 286 || ndist > 30)
+        return -1;
+
+    memset(lengths, 0, 19);
+    for (i = 0; i < nclen; i++) {
+        if ((v = bits_get(b, 3)) < 0)
+            return -1;
+        lengths[clen_order[i]] = (uint8_t)v;
+    }
+    if (huff_build(lit, lengths, 19) < 0)
+        return -1;
+
+    for (i = 0; i < nlit + ndist; ) {
+        if ((sym = huff_decode(b, lit)) < 0)
+            return -1;
+
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+
+        /* 16 repeats the previous length, 17 and 18 repeat zeros */
+        if (sym == 16 && i == 0)
+            return -1;
+        v = sym == 16 ? lengths[i - 1] : 0;
+        rep = bits_get(b, sym == 16 ? 2 : sym == 17 ? 3 : 7);
+        if (rep < 0)
+            return -1;
+        rep += sym == 18 ? 11 : 3;
+        if (i + rep > nlit + ndist)
+            return -1;
+        while (rep--)
+            lengths[i++] = (uint8_t)v;
+    }
+
+    /* A block needs its end code */
+    if (lengths[256] == 0)
+        return -1;
+
+    if (huff_build(lit, lengths, (int)nlit) < 0 ||
+            huff_build(dist, lengths + nlit, (int)ndist) < 0)
+        return -1;
+
+    return 0;
+}
+
+/* The codes of a fixed Huffman block */
+void inflate_fixed(huff_t* lit, huff_t* dist)
+{
+    uint8_t lengths[288];
+    int i;
+
+    for (i = 0; i < 144; i++)
+        lengths[i] = 8;
+    for (; i < 256; i++)
+        lengths[i] = 9;
+    for (; i < 280; i++)
+        lengths[i] = 7;
+    for (; i < 288; i++)
+        lengths[i] = 8;
+    huff_build(lit, lengths, 288);
+
+    for (i = 0; i < 30; i++)
+        lengths[i] = 5;
+    huff_build(dist, lengths, 30);
+}
+
+/* Decode the symbols of one compressed block onto out at *pos */
+int inflate_block(bits_t* b, const huff_t* lit, const huff_t* dist,
+    uint8_t* out, size_t out_len, size_t* pos)
+{
+    size_t at = *pos;
+    long len, d, e;
+    int sym;
+    uint8_t* dst;
+    const uint8_t* src;
+
+    for (;;) {
+        if ((sym = huff_decode(b, lit)) < 0)
+            return -1;
+
+        if (sym < 256) {
+            if (at >= out_len)
+                return -1;
+            out[at++] = (uint8_t)sym;
+            continue;
+        }
+
+        if (sym == 256)
+            break;
+
+        sym -= 257;
+        if (sym >= 29 || (e = bits_get(b, len_extra[sym])) < 0)
+            return -1;
+        len = len_base[sym] + e;
+
+        if ((sym = huff_decode(b, dist)) < 0 || sym >= 30 ||
+                (e = bits_get(b, dist_extra[sym])) < 0)
+            return -1;
+        d = dist_base[sym] + e;
+
+        if ((size_t)d > at || out_len - at < (size_t)len)
+            return -1;
+
+        dst = out + at;
+        src = dst - d;
+        at += (size_t)len;
+
+        /* Overlapping copies repeat the last d bytes */
+        if (d >= len) {
+            memcpy(dst, src, (size_t)len);
+        } else {
+            while (len--)
+                *dst++ = *src++;
+        }
+    }
+
+    *pos = at;
+    return 0;
+}
+
+long inflate_raw(uint8_t* out, size_t out_len, const uint8_t* in, size_t in_len)
+{
+    huff_t lit, dist;
+    bits_t b;
+    size_t pos = 0;
+    long last, type, len, nlen;
+
+    b.in = in;
+    b.end = in + in_len;
+    b.buf = 0;
+    b.count = 0;
+
+    do {
+        last = bits_get(&b, 1);
+        type = bits_get(&b, 2);
+        if (type < 0)
+            return -1;
+
+        if (type == 0) {
+            /* Stored: skip to a byte boundary, hand back the whole bytes
+               still buffered and copy straight from the input */
+            b.buf >>= b.count & 7;
+            b.count -= b.count & 7;
+            b.in -= b.count / 8;
+            b.buf = 0;
+            b.count = 0;
+
+            len = bits_get(&b, 16);
+            nlen = bits_get(&b, 16);
+            if (nlen < 0 || len != (~nlen & 0xFFFF))
+                return -1;
+            b.in -= b.count / 8;
+            b.buf = 0;
+            b.count = 0;
+
+            if ((size_t)(b.end - b.in) < (size_t)len || out_len - pos < (size_t)len)
+                return -1;
+            memcpy(out + pos, b.in, (size_t)len);
+            b.in += len;
+            pos += (size_t)len;
+        } else if (type == 1) {
+            inflate_fixed(&lit, &dist);
+            if (inflate_block(&b, &lit, &dist, out, out_len, &pos) < 0)
+                return -1;
+        } else if (type == 2) {
+            if (inflate_tables(&b, &lit, &dist) < 0 ||
+                    inflate_block(&b, &lit, &dist, out, out_len, &pos) < 0)
+                return -1;
+        } else {
+            return -1;
+        }
+    } while (!last);
+
+    return (long)pos;
+}
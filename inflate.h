@@ -0,0 +1,42 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef _INFLATE_H
+#define _INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Decode the raw DEFLATE (RFC 1951) stream in[0..in_len) into out, which
+   has room for out_len bytes. Returns the bytes written, or -1 if the
+   stream is corrupt, truncated or doesn't fit. */
+long inflate_raw(uint8_t* out, size_t out_len, const uint8_t* in, size_t in_len);
+
+/* Continue the CRC-32 (as in gzip and zip) crc over len bytes of p, start
+   with 0 */
+uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t len);
+
+#endif
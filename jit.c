@@ -0,0 +1,427 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifdef _JIT
+#if !defined(__x86_64__) && !defined(_M_X64)
+#error "_JIT needs an x86-64 host"
+#endif
+
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include "agb.h"
+#include "jit.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define JIT_BUF_SIZE (1 << 20) /* Code buffer bytes */
+#define JIT_BLOCK_MAX 4096     /* Worst case bytes of code per block */
+
+/* Offset of a field of gb */
+#define OFF(field) ((int32_t)((uint8_t*)&(field) - (uint8_t*)gb))
+
+/* Map j's buffer, returns -1 on failure. It is never writable and
+   executable at once: jit_compile() makes it writable while it emits
+   code, and executable again when done. */
+int jit_map(jit_t* j)
+{
+    void* buf = mmap(NULL, JIT_BUF_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (buf == MAP_FAILED) {
+        j->failed = 1;
+        return -1;
+    }
+
+    j->buf = (uint8_t*)buf;
+    j->used = 0;
+    return 0;
+}
+
+void jit_free(jit_t* j)
+{
+    if (j->buf != NULL)
+        munmap(j->buf, JIT_BUF_SIZE);
+
+    j->buf = NULL;
+    j->used = 0;
+    j->epoch++;
+}
+
+/* Emitters */
+void put_8(uint8_t** p, uint8_t v)
+{
+    *(*p)++ = v;
+}
+
+void put_16(uint8_t** p, uint16_t v)
+{
+    put_8(p, v & 0xFF);
+    put_8(p, v >> 8);
+}
+
+void put_32(uint8_t** p, uint32_t v)
+{
+    put_16(p, v & 0xFFFF);
+    put_16(p, v >> 16);
+}
+
+void put_64(uint8_t** p, uint64_t v)
+{
+    put_32(p, (uint32_t)v);
+    put_32(p, (uint32_t)(v >> 32));
+}
+
+/* Point the rel32 at at to target */
+void patch_32(uint8_t* at, uint8_t* target)
+{
+    put_32(&at, (uint32_t)(target - (at + 4)));
+}
+
+/* ModRM byte with a 32-bit displacement */
+void put_disp(uint8_t** p, uint8_t modrm, int32_t off)
+{
+    put_8(p, modrm);
+    put_32(p, (uint32_t)off);
+}
+
+/* Host registers by encoding. Byte registers 4 to 7 are AH CH DH BH as
+   long as there is no REX prefix. */
+#define RAX 0
+#define RCX 1
+#define RDX 2
+#define RBX 3
+#define RBP 5
+
+/* ModRM operand [rbp+off], gb's field at off */
+void put_mem(uint8_t** p, uint8_t reg, int32_t off)
+{
+    put_disp(p, (uint8_t)(0x80 | reg << 3 | RBP), off);
+}
+
+/*
+ * Guest registers in host registers. Inline code keeps AF BC DE HL in
+ * eax ecx edx ebx, so both bytes of each pair are byte registers, and
+ * an 8-bit register is whichever of them holds the byte the REG_ macros
+ * name: A in ah, B C in ch cl, and so on. A pair is loaded
+ * the first time inline code needs it and written back before the next
+ * handler call, which sees and may change gb->cpu as usual, and at the
+ * end of the block. SP stays in gb->cpu. Masks have a bit per host
+ * register.
+ */
+typedef struct {
+    int32_t off[4]; /* Offset of AF BC DE HL in gb, by host register */
+    int32_t sp_off; /* Offset of SP in gb */
+    int8_t reg8[8]; /* Byte register of B C D E H L (HL) A, -1 for (HL) */
+    uint8_t loaded; /* Pairs held in their host register */
+    uint8_t dirty;  /* Pairs changed since they were loaded */
+} regs_t;
+
+/* Set the byte register of guest register n, the one at off in gb. The
+   low byte of a pair is AL CL DL BL, the high one AH CH DH BH. */
+void map_reg8(regs_t* r, uint8_t n, int32_t off)
+{
+    int8_t reg;
+
+    for (reg = RAX; reg <= RBX; reg++) {
+        if (off == r->off[reg] || off == r->off[reg] + 1)
+            r->reg8[n] = (int8_t)(reg | (off - r->off[reg]) << 2);
+    }
+}
+
+/* Load the pairs in mask that aren't held yet */
+void put_load(uint8_t** p, regs_t* r, uint8_t mask)
+{
+    uint8_t reg;
+
+    for (reg = RAX; reg <= RBX; reg++) {
+        if ((mask & ~r->loaded) & 1 << reg) {
+            put_8(p, 0x0F); put_8(p, 0xB7); put_mem(p, reg, r->off[reg]); /* movzx reg, word [rbp+off] */
+            r->loaded |= 1 << reg;
+        }
+    }
+}
+
+/* Write back the changed pairs and give up the host registers */
+void put_spill(uint8_t** p, regs_t* r)
+{
+    uint8_t reg;
+
+    for (reg = RAX; reg <= RBX; reg++) {
+        if (r->dirty & 1 << reg) {
+            put_8(p, 0x66); put_8(p, 0x89); put_mem(p, reg, r->off[reg]); /* mov [rbp+off], reg16 */
+        }
+    }
+
+    r->loaded = 0;
+    r->dirty = 0;
+}
+
+/* Emit the instruction inline if it only moves or loads registers,
+   returns 0 if it needs its handler */
+int put_native(uint8_t** p, const dinsn_t* d, regs_t* r)
+{
+    /* Host registers of BC DE HL SP, as an opcode's register field
+       names them */
+    static const int8_t reg16[4] = { RCX, RDX, RBX, -1 };
+    const int8_t* reg8 = r->reg8;
+    uint8_t op = d->op;
+    int dst, src;
+
+    /* NOP */
+    if (op == 0x00)
+        return 1;
+
+    /* LD r,r' */
+    if (op >= 0x40 && op < 0x80) {
+        dst = reg8[(op >> 3) & 7];
+        src = reg8[op & 7];
+        if (dst < 0 || src < 0)
+            return 0;
+        if (dst != src) {
+            put_load(p, r, (uint8_t)(1 << (dst & 3) | 1 << (src & 3)));
+            put_8(p, 0x88); put_8(p, (uint8_t)(0xC0 | src << 3 | dst)); /* mov dst, src */
+            r->dirty |= 1 << (dst & 3);
+        }
+        return 1;
+    }
+
+    /* LD r,n */
+    if ((op & 0xC7) == 0x06 && op != 0x36) {
+        dst = reg8[(op >> 3) & 7];
+        put_load(p, r, (uint8_t)(1 << (dst & 3)));
+        put_8(p, (uint8_t)(0xB0 | dst)); put_8(p, (uint8_t)d->imm); /* mov dst, n */
+        r->dirty |= 1 << (dst & 3);
+        return 1;
+    }
+
+    /* LD rr,nn / INC rr / DEC rr */
+    switch (op & 0xCF) {
+    case 0x01:
+        dst = reg16[op >> 4];
+        if (dst < 0) {
+            put_8(p, 0x66); put_8(p, 0xC7); put_mem(p, 0, r->sp_off); /* mov [rbp+sp], nn */
+            put_16(p, d->imm);
+            return 1;
+        }
+        put_8(p, (uint8_t)(0xB8 | dst)); put_32(p, d->imm);           /* mov dst, nn */
+        r->loaded |= 1 << dst;
+        r->dirty |= 1 << dst;
+        return 1;
+    case 0x03:
+    case 0x0B:
+        /* FF /0 is INC, FF /1 DEC */
+        dst = reg16[op >> 4];
+        src = (op & 0x08) >> 3;
+        if (dst < 0) {
+            put_8(p, 0x66); put_8(p, 0xFF); put_mem(p, (uint8_t)src, r->sp_off); /* inc/dec word [rbp+sp] */
+            return 1;
+        }
+        put_load(p, r, (uint8_t)(1 << dst));
+        put_8(p, 0x66); put_8(p, 0xFF); put_8(p, (uint8_t)(0xC0 | src << 3 | dst)); /* inc/dec dst16 */
+        r->dirty |= 1 << dst;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Advance sys_clock to the start of d, from the clk_m and clk_t the
+   code has already added */
+void put_clock(uint8_t** p, const dinsn_t* d, uint16_t* clk_m, uint16_t* clk_t)
+{
+    int32_t m_off = (int32_t)offsetof(agb_t, cpu.sys_clock.m);
+    int32_t t_off = (int32_t)offsetof(agb_t, cpu.sys_clock.t);
+
+    if (d->pre_m != *clk_m) {
+        put_8(p, 0x81); put_mem(p, 0, m_off);   /* add [rbp+sys_clock.m], dm */
+        put_32(p, (uint32_t)(d->pre_m - *clk_m));
+        *clk_m = d->pre_m;
+    }
+    if (d->pre_t != *clk_t) {
+        put_8(p, 0x81); put_mem(p, 0, t_off);   /* add [rbp+sys_clock.t], dt */
+        put_32(p, (uint32_t)(d->pre_t - *clk_t));
+        *clk_t = d->pre_t;
+    }
+}
+
+jitfn_t jit_compile(agb_t* gb, const dblock_t* b)
+{
+    jit_t* j = &gb->jit;
+    int32_t mmu_off = OFF(gb->cpu.mmu);
+    int32_t pc_off = OFF(REG_PC);
+    int32_t gen_off = (int32_t)(offsetof(mmu_t, page_gen) + (b->pc >> 8) * sizeof(uint32_t));
+    int32_t map_off = (int32_t)offsetof(mmu_t, map_gen);
+    regs_t r;
+    uint8_t* exits[3 * DBLOCK_MAX];
+    uint8_t exit_k[3 * DBLOCK_MAX];
+    uint8_t nexits = 0;
+    uint16_t clk_m = 0, clk_t = 0;
+    uint8_t* start;
+    uint8_t* p;
+    uint8_t* epilogue;
+    const dinsn_t* d;
+    uint16_t pc = b->pc;
+    int native = 0;
+    uint8_t i;
+
+    if (b->count == 0 || j->failed)
+        return NULL;
+    if (j->buf == NULL && jit_map(j) < 0)
+        return NULL;
+    if (mprotect(j->buf, JIT_BUF_SIZE, PROT_READ | PROT_WRITE) < 0) {
+        j->failed = 1;
+        j->epoch++;
+        return NULL;
+    }
+
+    /* Out of room, start over. Everything compiled so far goes with it. */
+    if (j->used + JIT_BLOCK_MAX > JIT_BUF_SIZE) {
+        j->used = 0;
+        j->epoch++;
+    }
+
+    start = p = j->buf + j->used;
+
+    r.off[RAX] = OFF(REG_AF);
+    r.off[RCX] = OFF(REG_BC);
+    r.off[RDX] = OFF(REG_DE);
+    r.off[RBX] = OFF(REG_HL);
+    r.sp_off = OFF(REG_SP);
+    r.loaded = 0;
+    r.dirty = 0;
+
+    /* The 8-bit registers go where cpu.h puts them */
+    map_reg8(&r, 0, OFF(REG_B));
+    map_reg8(&r, 1, OFF(REG_C));
+    map_reg8(&r, 2, OFF(REG_D));
+    map_reg8(&r, 3, OFF(REG_E));
+    map_reg8(&r, 4, OFF(REG_H));
+    map_reg8(&r, 5, OFF(REG_L));
+    r.reg8[6] = -1;
+    map_reg8(&r, 7, OFF(REG_A));
+
+    /* Prologue: rbp = gb, r12d = map_gen, r13d = page_gen of the block.
+       Four pushes and the padding keep rsp 16-byte aligned for calls. */
+    put_8(&p, 0x55);                                /* push rbp */
+    put_8(&p, 0x53);                                /* push rbx */
+    put_8(&p, 0x41); put_8(&p, 0x54);               /* push r12 */
+    put_8(&p, 0x41); put_8(&p, 0x55);               /* push r13 */
+    put_8(&p, 0x48); put_8(&p, 0x83); put_8(&p, 0xEC); put_8(&p, 8); /* sub rsp, 8 */
+    put_8(&p, 0x48); put_8(&p, 0x89); put_8(&p, 0xFD); /* mov rbp, rdi */
+    put_8(&p, 0x48); put_8(&p, 0x8B); put_mem(&p, RAX, mmu_off);   /* mov rax, [rbp+mmu] */
+    put_8(&p, 0x44); put_8(&p, 0x8B); put_disp(&p, 0xA0, map_off); /* mov r12d, [rax+map_gen] */
+    put_8(&p, 0x44); put_8(&p, 0x8B); put_disp(&p, 0xA8, gen_off); /* mov r13d, [rax+page_gen] */
+    put_8(&p, 0xC7); put_mem(&p, 0, OFF(gb->cpu.ins_clock.m));     /* mov [rbp+ins_clock.m], 0 */
+    put_32(&p, 0);
+
+    for (i = 0; i < b->count; i++) {
+        d = &b->ins[i];
+        native = put_native(&p, d, &r);
+
+        if (!native) {
+            /* Handlers see the registers in gb->cpu, and sys_clock at
+               the start of their instruction */
+            put_spill(&p, &r);
+            put_clock(&p, d, &clk_m, &clk_t);
+
+            /* Handlers expect PC past the opcode and the operand in imm */
+            put_8(&p, 0x66); put_8(&p, 0xC7); put_mem(&p, 0, pc_off);
+            put_16(&p, (uint16_t)(pc + d->len));
+            put_8(&p, 0x66); put_8(&p, 0xC7); put_mem(&p, 0, OFF(gb->cpu.imm));
+            put_16(&p, d->imm);
+            put_8(&p, 0x48); put_8(&p, 0x89); put_8(&p, 0xEF);                 /* mov rdi, rbp */
+            put_8(&p, 0x48); put_8(&p, 0xB8); put_64(&p, (uint64_t)(size_t)d->fn); /* mov rax, fn */
+            put_8(&p, 0xFF); put_8(&p, 0xD0);                                    /* call rax */
+
+            /* Leave if the handler ended the slice, wrote to this page or
+               switched banks. Nothing is cached here, rax is free. */
+            if (i + 1 < b->count) {
+                put_8(&p, 0x83); put_mem(&p, 7, OFF(gb->cpu.slice));          /* cmp [rbp+slice], 0 */
+                put_8(&p, 0);
+                put_8(&p, 0x0F); put_8(&p, 0x84);                             /* je exit */
+                exits[nexits] = p;
+                exit_k[nexits++] = i + 1;
+                put_32(&p, 0);
+                put_8(&p, 0x48); put_8(&p, 0x8B); put_mem(&p, RAX, mmu_off);  /* mov rax, [rbp+mmu] */
+                put_8(&p, 0x44); put_8(&p, 0x39); put_disp(&p, 0xA8, gen_off); /* cmp [rax+page_gen], r13d */
+                put_8(&p, 0x0F); put_8(&p, 0x85);                             /* jne exit */
+                exits[nexits] = p;
+                exit_k[nexits++] = i + 1;
+                put_32(&p, 0);
+                put_8(&p, 0x44); put_8(&p, 0x39); put_disp(&p, 0xA0, map_off); /* cmp [rax+map_gen], r12d */
+                put_8(&p, 0x0F); put_8(&p, 0x85);                             /* jne exit */
+                exits[nexits] = p;
+                exit_k[nexits++] = i + 1;
+                put_32(&p, 0);
+            }
+        }
+
+        pc += d->size;
+    }
+
+    put_spill(&p, &r);
+
+    /* Inline code doesn't move PC */
+    if (native) {
+        put_8(&p, 0x66); put_8(&p, 0xC7); put_mem(&p, 0, pc_off);
+        put_16(&p, pc);
+    }
+
+    put_clock(&p, &b->ins[b->count - 1], &clk_m, &clk_t);
+    put_8(&p, 0xB8); put_32(&p, b->count);          /* mov eax, count */
+
+    epilogue = p;
+    put_8(&p, 0x48); put_8(&p, 0x83); put_8(&p, 0xC4); put_8(&p, 8); /* add rsp, 8 */
+    put_8(&p, 0x41); put_8(&p, 0x5D);               /* pop r13 */
+    put_8(&p, 0x41); put_8(&p, 0x5C);               /* pop r12 */
+    put_8(&p, 0x5B);                                /* pop rbx */
+    put_8(&p, 0x5D);                                /* pop rbp */
+    put_8(&p, 0xC3);                                /* ret */
+
+    for (i = 0; i < nexits; i++) {
+        patch_32(exits[i], p);
+        put_8(&p, 0xB8); put_32(&p, exit_k[i]);     /* mov eax, k */
+        put_8(&p, 0xE9);                            /* jmp epilogue */
+        patch_32(p, epilogue);
+        p += 4;
+    }
+
+    j->used += (uint32_t)(p - start);
+
+    /* Nothing compiled can run if the buffer can't be made executable */
+    if (mprotect(j->buf, JIT_BUF_SIZE, PROT_READ | PROT_EXEC) < 0) {
+        j->failed = 1;
+        j->epoch++;
+        return NULL;
+    }
+
+    return (jitfn_t)(size_t)start;
+}
+#endif
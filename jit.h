@@ -0,0 +1,69 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef _JIT_H
+#define _JIT_H
+
+#include "cpu.h"
+#ifdef _JIT_VERIFY
+#include "ppu.h"
+#endif
+
+/*
+ * Block compiler for x86-64 hosts. Blocks from the decode cache that run
+ * often are turned into native code: register loads and moves are emitted
+ * inline on guest registers held in host registers, everything else calls
+ * its handler with the registers written back, and the block is left early
+ * as soon as its code is written to or a bank is switched.
+ */
+#define JIT_THRESHOLD 64 /* Interpreted runs before a block is compiled */
+
+typedef uint32_t (*jitfn_t)(agb_t* gb);
+
+/* Code buffer, one per context so contexts can run on any thread */
+typedef struct {
+    uint8_t* buf;   /* Mapped on first use */
+    uint32_t used;  /* Bytes handed out */
+    uint32_t epoch; /* Bumped whenever the buffer is recycled, code
+                       compiled before that is gone */
+    uint8_t failed; /* Mapping or protecting the buffer failed */
+#ifdef _JIT_VERIFY
+    /* Copies verify_native() takes, too big for a worker's stack */
+    mmu_t mmu;                      /* MMU before the block */
+    ppu_t ppu;                      /* LCD before the block */
+    ppu_t ppu_native;               /* LCD after the native run */
+    mmuwrite_t writes[MMU_LOG_MAX]; /* What the native run wrote */
+#endif
+} jit_t;
+
+/* Compile a block into gb's code buffer, returns NULL if it can't. The
+   code returns how many of the block's instructions it ran. */
+jitfn_t jit_compile(agb_t* gb, const dblock_t* b);
+
+/* Unmap a code buffer */
+void jit_free(jit_t* j);
+
+#endif
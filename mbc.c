@@ -0,0 +1,299 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <string.h>
+#include "mmu.h"
+
+void mbc_init(mbc_t* mbc, const rom_t* rom)
+{
+    uint8_t type = rom->header.type;
+
+    mbc->has_rtc = 0;
+
+    if (type >= 0x01 && type <= 0x03) {
+        mbc->type = MBC_1;
+    } else if (type >= 0x0F && type <= 0x13) {
+        mbc->type = MBC_3;
+        mbc->has_rtc = type <= 0x10;
+    } else if (type >= 0x19 && type <= 0x1E) {
+        mbc->type = MBC_5;
+    } else {
+        /* TODO: MBC2, HuC1 and the rest */
+        mbc->type = MBC_NONE;
+    }
+
+    switch (type) {
+    case 0x03: case 0x06: case 0x09: case 0x0D: case 0x0F:
+    case 0x10: case 0x13: case 0x1B: case 0x1E: case 0xFF:
+        mbc->battery = 1;
+        break;
+    default:
+        mbc->battery = 0;
+    }
+
+    mbc->rom_banks = (uint16_t)(rom->size / 0x4000);
+    mbc->ram_banks = rom->header.ram_banks;
+
+    mbc->rtc.halt = 0;
+    mbc->rtc.carry = 0;
+    mbc->rtc.base = time(NULL);
+    mbc->rtc.frozen = 0;
+    mbc->rtc.save = NULL;
+
+    mbc_reset(mbc);
+}
+
+void mbc_reset(mbc_t* mbc)
+{
+    /* Without an MBC, RAM (if any) is just there */
+    mbc->ram_on = mbc->type == MBC_NONE;
+    mbc->mode = 0;
+    mbc->lo = 1;
+    mbc->hi = 0;
+    mbc->rtc.latch = 0xFF;
+}
+
+/* Map in the given banks, only touching the parts of the map that move */
+void mbc_bank(mmu_t* mmu, uint16_t rom, uint16_t rom0, uint8_t ram)
+{
+    if (rom != mmu->rom_bank) {
+        mmu->rom_bank = rom;
+        mmu_map_rom(mmu);
+    }
+
+    if (rom0 != mmu->rom_bank0) {
+        mmu->rom_bank0 = rom0;
+        mmu_map_rom0(mmu);
+    }
+
+    if (ram != mmu->ram_bank) {
+        mmu->ram_bank = ram;
+        mmu_map_ram(mmu);
+    }
+}
+
+void mbc_write(mmu_t* mmu, uint16_t addr, uint8_t val)
+{
+    mbc_t* mbc = &mmu->mbc;
+    uint16_t banks = mbc->rom_banks;
+    uint8_t on;
+
+    if (mbc->type == MBC_NONE)
+        return;
+
+    if (addr < 0x2000) {
+        on = (val & 0x0F) == 0x0A;
+        if (on != mbc->ram_on) {
+            mbc->ram_on = on;
+            mmu_map_ram(mmu);
+        }
+        return;
+    }
+
+    switch (mbc->type) {
+    case MBC_1:
+        if (addr < 0x4000)
+            mbc->lo = (val & 0x1F) ? val & 0x1F : 1;
+        else if (addr < 0x6000)
+            mbc->hi = val & 0x03;
+        else
+            mbc->mode = val & 0x01;
+
+        /* Mode 1 moves the high bits to bank 0 and RAM */
+        mbc_bank(mmu, ((mbc->hi << 5) | mbc->lo) % banks,
+            mbc->mode ? (mbc->hi << 5) % banks : 0,
+            mbc->mode ? mbc->hi : 0);
+        break;
+
+    case MBC_3:
+        if (addr < 0x4000) {
+            mbc->lo = (val & 0x7F) ? val & 0x7F : 1;
+            mbc_bank(mmu, mbc->lo % banks, 0, mmu->ram_bank);
+        } else if (addr < 0x6000) {
+            mbc_bank(mmu, mmu->rom_bank, 0, val & 0x0F);
+        } else {
+            if (mbc->rtc.latch == 0x00 && val == 0x01) {
+                rtc_latch(&mbc->rtc);
+                rtc_store(mmu);
+            }
+            mbc->rtc.latch = val;
+        }
+        break;
+
+    case MBC_5:
+        if (addr < 0x3000)
+            mbc->lo = val;
+        else if (addr < 0x4000)
+            mbc->hi = val & 0x01;
+        else if (addr < 0x6000)
+            mbc_bank(mmu, mmu->rom_bank, 0, val & 0x0F);
+
+        if (addr < 0x4000)
+            mbc_bank(mmu, ((mbc->hi << 8) | mbc->lo) % banks, 0, mmu->ram_bank);
+        break;
+    }
+}
+
+/* Clock counter in seconds */
+uint32_t rtc_now(const rtc_t* rtc)
+{
+    if (rtc->halt)
+        return rtc->frozen;
+
+    return (uint32_t)(time(NULL) - rtc->base);
+}
+
+/* Restart the counter at s seconds */
+void rtc_set(rtc_t* rtc, uint32_t s)
+{
+    if (rtc->halt)
+        rtc->frozen = s;
+    else
+        rtc->base = time(NULL) - (time_t)s;
+}
+
+/* Split the running clock into register values */
+void rtc_split(rtc_t* rtc, uint8_t* reg)
+{
+    uint32_t s = rtc_now(rtc);
+    uint32_t days = s / 86400;
+
+    /* The day counter is 9 bits, overflowing sets carry until cleared */
+    if (days > 0x1FF) {
+        rtc->carry = 1;
+        days &= 0x1FF;
+        rtc_set(rtc, s % 86400 + days * 86400);
+    }
+
+    reg[RTC_S] = (uint8_t)(s % 60);
+    reg[RTC_M] = (uint8_t)(s / 60 % 60);
+    reg[RTC_H] = (uint8_t)(s / 3600 % 24);
+    reg[RTC_DL] = (uint8_t)days;
+    reg[RTC_DH] = (uint8_t)((days >> 8) | (rtc->halt << 6) | (rtc->carry << 7));
+}
+
+void rtc_latch(rtc_t* rtc)
+{
+    rtc_split(rtc, rtc->reg);
+}
+
+void rtc_load(rtc_t* rtc)
+{
+    const uint8_t* p = rtc->save;
+    uint8_t reg[RTC_REGS];
+    uint64_t then = 0;
+    time_t now = time(NULL);
+    uint32_t s;
+    int i;
+
+    if (p == NULL)
+        return;
+
+    for (i = 7; i >= 0; i--)
+        then = (then << 8) | p[40 + i];
+    if (then == 0)
+        return;
+
+    /* Registers are the low byte of each word */
+    for (i = 0; i < RTC_REGS; i++) {
+        reg[i] = p[i * 4];
+        rtc->reg[i] = p[(RTC_REGS + i) * 4];
+    }
+
+    s = ((((reg[RTC_DH] & 0x01) << 8 | reg[RTC_DL]) * 24 + reg[RTC_H] % 24) * 60 +
+        reg[RTC_M] % 60) * 60 + reg[RTC_S] % 60;
+    rtc->halt = (reg[RTC_DH] >> 6) & 1;
+    rtc->carry = reg[RTC_DH] >> 7;
+
+    /* A running clock went on while nothing was running it */
+    if (!rtc->halt && (uint64_t)now > then)
+        s += (uint32_t)((uint64_t)now - then);
+
+    rtc_set(rtc, s);
+}
+
+void rtc_store(mmu_t* mmu)
+{
+    rtc_t* rtc = &mmu->mbc.rtc;
+    uint8_t* p = rtc->save;
+    uint8_t reg[RTC_REGS];
+    uint64_t now = (uint64_t)time(NULL);
+    int i;
+
+    if (p == NULL)
+        return;
+
+    rtc_split(rtc, reg);
+    memset(p, 0, RTC_SAVE_SIZE);
+    for (i = 0; i < RTC_REGS; i++) {
+        p[i * 4] = reg[i];
+        p[(RTC_REGS + i) * 4] = rtc->reg[i];
+    }
+    for (i = 0; i < 8; i++, now >>= 8)
+        p[40 + i] = (uint8_t)now;
+
+    if (mmu->battery)
+        battery_dirty(mmu->battery, (uint32_t)(p - mmu->battery->data));
+}
+
+uint8_t rtc_read(rtc_t* rtc, uint8_t reg)
+{
+    return reg < RTC_REGS ? rtc->reg[reg] : 0xFF;
+}
+
+void rtc_write(rtc_t* rtc, uint8_t reg, uint8_t val)
+{
+    uint32_t s = rtc_now(rtc);
+    uint32_t sec = s % 60;
+    uint32_t min = s / 60 % 60;
+    uint32_t hour = s / 3600 % 24;
+    uint32_t days = s / 86400 & 0x1FF;
+
+    switch (reg) {
+    case RTC_S:
+        sec = val % 60;
+        break;
+    case RTC_M:
+        min = val % 60;
+        break;
+    case RTC_H:
+        hour = val % 24;
+        break;
+    case RTC_DL:
+        days = (days & 0x100) | val;
+        break;
+    case RTC_DH:
+        days = (days & 0xFF) | ((val & 0x01) << 8);
+        rtc->halt = (val >> 6) & 1;
+        rtc->carry = val >> 7;
+        break;
+    default:
+        return;
+    }
+
+    rtc_set(rtc, ((days * 24 + hour) * 60 + min) * 60 + sec);
+    rtc->reg[reg] = val;
+}
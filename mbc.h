@@ -0,0 +1,105 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef _MBC_H
+#define _MBC_H
+
+#include <stdint.h>
+#include <time.h>
+#include "rom.h"
+
+struct mmu;
+
+/* Memory bank controllers */
+#define MBC_NONE 0
+#define MBC_1    1
+#define MBC_3    3
+#define MBC_5    5
+
+/* MBC3 clock registers, selected as RAM banks 0x08-0x0C */
+enum {
+    RTC_S,
+    RTC_M,
+    RTC_H,
+    RTC_DL,
+    RTC_DH,
+    RTC_REGS
+};
+
+/* Bytes the clock takes after the RAM in the save file: the running and
+   latched registers as 32-bit words, then the host time they were saved
+   at as a 64-bit one, all little-endian, as other emulators keep it */
+#define RTC_SAVE_SIZE 48
+
+/* MBC3 real time clock. It counts host time, so with a battery to keep
+   it in the save file it keeps going while the emulator isn't running. */
+typedef struct {
+    uint8_t reg[RTC_REGS]; /* Latched registers */
+    uint8_t latch;         /* Last write to the latch register */
+    uint8_t halt;          /* Stopped, DH bit 6 */
+    uint8_t carry;         /* Day counter overflowed, DH bit 7 */
+    time_t base;           /* Host time the counter was at zero, while running */
+    uint32_t frozen;       /* Counter in seconds, while halted */
+    uint8_t* save;         /* RTC_SAVE_SIZE bytes in the save file, or NULL */
+} rtc_t;
+
+typedef struct {
+    uint8_t type;       /* MBC_* */
+    uint8_t has_rtc;
+    uint8_t battery;    /* RAM is kept, see battery.h */
+    uint8_t ram_on;     /* Cartridge RAM and clock enabled */
+    uint8_t mode;       /* MBC1 banking mode */
+    uint8_t lo, hi;     /* Bank register writes, low and high bits */
+    uint16_t rom_banks; /* 16 KiB ROM banks */
+    uint8_t ram_banks;  /* 8 KiB RAM banks */
+    rtc_t rtc;
+} mbc_t;
+
+/* Set the MBC up from the cartridge header */
+void mbc_init(mbc_t* mbc, const rom_t* rom);
+
+/* Back to the power-on registers, the clock keeps going */
+void mbc_reset(mbc_t* mbc);
+
+/* Write to the MBC registers at 0x0000-0x7FFF */
+void mbc_write(struct mmu* mmu, uint16_t addr, uint8_t val);
+
+/* Copy the running clock into the registers */
+void rtc_latch(rtc_t* rtc);
+
+/* Pick the clock up from rtc->save, counting the time since it was
+   stored. Leaves it as it is if nothing was stored there yet. */
+void rtc_load(rtc_t* rtc);
+
+/* Store the clock in the save file, if it has one */
+void rtc_store(struct mmu* mmu);
+
+/* Clock register access while one is mapped at 0xA000-0xBFFF */
+uint8_t rtc_read(rtc_t* rtc, uint8_t reg);
+void rtc_write(rtc_t* rtc, uint8_t reg, uint8_t val);
+
+#endif
+
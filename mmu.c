@@ -24,11 +24,32 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 */
 
-#include "mmu.h"
+#include <stdlib.h>
+#include <string.h>
+#include "agb.h"
 
+#ifdef _JIT_VERIFY
+#include <stdio.h>
+#endif
+
+#define ARENA_ALIGN 64 /* Cache line */
+#define ARENA_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/*
+ * An instance lives in one arena: the mmu_t, then WRAM, VRAM, OAM, IO,
+ * HRAM and cartridge RAM, each starting on a cache line. Battery RAM is
+ * the exception, it is mapped from the save file.
+ */
 mmu_t* mmu_init(char* name)
 {
-    mmu_t* mmu = (mmu_t*)malloc(sizeof(mmu_t));
+    rom_t* rom = rom_load(name);
+    battery_t* battery = NULL;
+    mbc_t mbc;
+    mmu_t* mmu;
+    uint8_t* raw;
+    uint8_t* p;
+    size_t ram_size;
+    size_t eram_size;
 
     uint8_t bios[256] = {
         0x31, 0xFE, 0xFF, 0xAF, 0x21, 0xFF, 0x9F, 0x32, 0xCB, 0x7C, 0x20, 0xFB, 0x21, 0x26, 0xFF, 0x0E,
@@ -49,56 +70,647 @@ mmu_t* mmu_init(char* name)
         0xF5, 0x06, 0x19, 0x78, 0x86, 0x23, 0x05, 0x20, 0xFB, 0x86, 0x20, 0xFE, 0x3E, 0x01, 0xE0, 0x50
     };
 
-    memcpy(bios, mmu->bios, 256);
+    if (rom == NULL)
+        return NULL;
+
+    mbc_init(&mbc, rom);
+
+    /* The clock is kept after the RAM, and needs the file even without */
+    ram_size = mbc.ram_banks * ERAM_SIZE;
+    if (mbc.battery && (ram_size || mbc.has_rtc)) {
+        /* Running on without the save would lose it without a word */
+        battery = battery_open(name, ram_size + (mbc.has_rtc ? RTC_SAVE_SIZE : 0));
+        if (battery == NULL) {
+            rom_free(rom);
+            return NULL;
+        }
+    }
+    eram_size = battery ? 0 : ram_size;
+
+    raw = (uint8_t*)malloc(ARENA_UP(sizeof(mmu_t)) + WRAM_SIZE + VRAM_SIZE +
+        OAM_SIZE + IO_SIZE + ZRAM_SIZE + eram_size + ARENA_ALIGN - 1);
+    if (raw == NULL) {
+        if (battery)
+            battery_close(battery);
+        rom_free(rom);
+        return NULL;
+    }
+
+    p = (uint8_t*)ARENA_UP((size_t)raw);
+    mmu = (mmu_t*)p;
+    memset(mmu, 0, sizeof(mmu_t));
+    p += ARENA_UP(sizeof(mmu_t));
+
+    mmu->arena = raw;
+    mmu->wram = p;
+    p += WRAM_SIZE;
+    mmu->vram = p;
+    p += VRAM_SIZE;
+    mmu->oam = p;
+    p += OAM_SIZE;
+    mmu->io = p;
+    p += IO_SIZE;
+    mmu->zram = p;
+    p += ZRAM_SIZE;
+    mmu->eram = battery && ram_size ? battery->data : eram_size ? p : NULL;
+
+    mmu->rom = rom;
+    mmu->mbc = mbc;
+    mmu->battery = battery;
+    if (battery && mbc.has_rtc) {
+        mmu->mbc.rtc.save = battery->data + ram_size;
+        rtc_load(&mmu->mbc.rtc);
+    }
+    mmu->gb = NULL;
+    memcpy(mmu->bios, bios, 256);
 
-    /* TODO: Need error handling */
-    mmu->rom = rom_load(name);
+    mmu_reset(mmu);
 
     return mmu;
 }
 
+void mmu_free(mmu_t* mmu)
+{
+    if (mmu->battery) {
+        rtc_store(mmu);
+        battery_close(mmu->battery);
+    }
+    rom_free(mmu->rom);
+    free(mmu->arena);
+}
+
+/* Point count pages from first on at base, NULL to leave them to the IO
+   handlers */
+void map_pages(mmu_t* mmu, int first, int count, uint8_t* base, int writable)
+{
+    int i;
+
+    /* Nothing outside page 0xFF is reachable during OAM DMA */
+    if (mmu->dma_lock)
+        base = NULL;
+
+    for (i = 0; i < count; i++) {
+        mmu->read_map[first + i] = base ? base + i * 256 : NULL;
+        mmu->write_map[first + i] = base && writable ? base + i * 256 : NULL;
+    }
+}
+
+void mmu_map_rom(mmu_t* mmu)
+{
+    map_pages(mmu, 0x40, 0x40, mmu->rom->prg + mmu->rom_bank * 0x4000, 0);
+
+#ifdef _DECODE_CACHE
+    mmu->map_gen++;
+#endif
+}
+
+void mmu_map_rom0(mmu_t* mmu)
+{
+    map_pages(mmu, 0x00, 0x40, mmu->rom->prg + mmu->rom_bank0 * 0x4000, 0);
+    if (mmu->in_bios)
+        mmu->read_map[0x00] = mmu->bios;
+
+#ifdef _DECODE_CACHE
+    mmu->map_gen++;
+#endif
+}
+
+/* Whether a clock register rather than RAM is mapped at 0xA000 */
+#define RTC_MAPPED(mmu) ((mmu)->mbc.has_rtc && ((mmu)->ram_bank & 0x08))
+
+void mmu_map_ram(mmu_t* mmu)
+{
+    uint8_t* base = NULL;
+#ifdef _DECODE_CACHE
+    int i;
+#endif
+
+    if (mmu->mbc.ram_on && mmu->mbc.ram_banks && !RTC_MAPPED(mmu))
+        base = mmu->eram + (mmu->ram_bank % mmu->mbc.ram_banks) * ERAM_SIZE;
+
+    /* Writes to battery RAM go through mmu_io_write() to be tracked */
+    map_pages(mmu, 0xA0, 0x20, base, mmu->battery == NULL);
+
+#ifdef _DECODE_CACHE
+    /* Blocks decoded from RAM aren't told apart by bank */
+    for (i = 0xA0; i < 0xC0; i++)
+        mmu->page_gen[i]++;
+    mmu->map_gen++;
+#endif
+}
+
+void mmu_map(mmu_t* mmu)
+{
+    mmu_map_rom0(mmu);
+    mmu_map_rom(mmu);
+    mmu_map_ram(mmu);
+
+    /* VRAM and OAM writes go through mmu_io_write() to mark what changed */
+    map_pages(mmu, 0x80, 0x20, mmu->vram, 0);
+    map_pages(mmu, 0xC0, 0x20, mmu->wram, 1);
+    map_pages(mmu, 0xE0, 0x1E, mmu->wram, 1); /* Echo of 0xC000-0xDDFF */
+    map_pages(mmu, 0xFE, 0x01, mmu->oam, 0);
+    map_pages(mmu, 0xFF, 0x01, NULL, 0);
+}
+
+/* Mark the tile or map row holding VRAM offset off as changed */
+void vram_dirty(mmu_t* mmu, uint16_t off)
+{
+    if (off < VRAM_MAPS)
+        mmu->tile_dirty[off >> 9] |= (uint32_t)1 << ((off >> 4) & 31);
+    else
+        mmu->map_dirty[(off - VRAM_MAPS) >> 10] |= (uint32_t)1 << (((off - VRAM_MAPS) >> 5) & 31);
+}
+
+#ifdef _JIT_VERIFY
+/* Journal a write to addr, held at host (NULL for registers). A full
+   journal would hide differences, so that aborts. */
+void mmu_log(mmu_t* mmu, uint16_t addr, uint8_t old, uint8_t val, uint8_t* host)
+{
+    mmuwrite_t* w;
+
+    if (mmu->log_len == MMU_LOG_MAX) {
+        fprintf(stderr, "mmu: write journal full at $%x\n", addr);
+        abort();
+    }
+
+    w = &mmu->log[mmu->log_len++];
+    w->addr = addr;
+    w->old = old;
+    w->val = val;
+    w->host = host;
+}
+#endif
+
+/* DMA copy of len bytes into tracked memory at guest address addr, returns
+   whether anything changed */
+int dma_copy(mmu_t* mmu, uint16_t addr, uint8_t* dst, const uint8_t* src, size_t len)
+{
+#ifdef _JIT_VERIFY
+    size_t i;
+
+    if (mmu->logging)
+        for (i = 0; i < len; i++)
+            mmu_log(mmu, (uint16_t)(addr + i), dst[i], src[i], &dst[i]);
+#else
+    (void)mmu;
+    (void)addr;
+#endif
+
+    if (memcmp(dst, src, len) == 0)
+        return 0;
+    memmove(dst, src, len);
+    return 1;
+}
+
+/* Host memory holding len bytes from addr on (within one page), or buf
+   filled one read at a time where the page isn't mapped */
+const uint8_t* dma_source(mmu_t* mmu, uint16_t addr, uint8_t* buf, int len)
+{
+    int i;
+
+    if (mmu->read_map[addr >> 8])
+        return mmu->read_map[addr >> 8] + (addr & 0xFF);
+
+    for (i = 0; i < len; i++)
+        buf[i] = mmu_io_read(mmu, (uint16_t)(addr + i));
+    return buf;
+}
+
+void dma_end(struct agb* gb, uint32_t when)
+{
+    (void)when;
+
+    gb->cpu.mmu->dma_lock = 0;
+    mmu_map(gb->cpu.mmu);
+}
+
+/* Runs once the instruction that started the transfer is done. when is
+   the clock the write was made at, which every core agrees on. */
+void dma_begin(struct agb* gb, uint32_t when)
+{
+    sched_add(&gb->sched, EV_DMA, when + OAM_DMA_CLOCKS, dma_end);
+}
+
+/*
+ * OAM DMA. The 0xA0 bytes are copied at once, then the bus stays locked
+ * for as long as the transfer would take: everything but page 0xFF is
+ * unmapped, reads give 0xFF and writes are dropped.
+ */
+void oam_dma(mmu_t* mmu, uint8_t page)
+{
+    uint8_t buf[0xA0];
+
+    if (mmu->gb)
+        ppu_sync(mmu->gb);
+
+    /* A new transfer restarts a running one */
+    if (mmu->dma_lock) {
+        mmu->dma_lock = 0;
+        mmu_map(mmu);
+    }
+
+    /* The DMA sees WRAM at 0xE000 and up */
+    if (page >= 0xE0)
+        page -= 0x20;
+
+    if (dma_copy(mmu, 0xFE00, mmu->oam, dma_source(mmu, (uint16_t)(page << 8), buf, 0xA0), 0xA0)) {
+        mmu->oam_dirty = 1;
+#ifdef _DECODE_CACHE
+        mmu->page_gen[0xFE]++;
+#endif
+    }
+
+    /* Without a CPU there is no clock to end the lock with */
+    if (mmu->gb == NULL)
+        return;
+
+    mmu->dma_lock = 1;
+    mmu_map(mmu);
+    /* sys_clock is at the start of the writing instruction in every core,
+       native blocks included, and ins_clock holds what it has added since */
+    sched_add(&mmu->gb->sched, EV_DMA, mmu->gb->cpu.sys_clock.m + mmu->gb->cpu.ins_clock.m, dma_begin);
+    mmu->gb->cpu.slice = 0;
+}
+
+/* Copy count 16-byte blocks from hdma_src to VRAM at hdma_dst */
+void hdma_copy(mmu_t* mmu, uint8_t count)
+{
+    uint8_t buf[16];
+    uint16_t off;
+
+    if (mmu->gb)
+        ppu_sync(mmu->gb);
+
+    while (count--) {
+        off = mmu->hdma_dst & 0x1FF0;
+        if (dma_copy(mmu, (uint16_t)(0x8000 + off), mmu->vram + off,
+                dma_source(mmu, mmu->hdma_src, buf, 16), 16)) {
+            vram_dirty(mmu, off);
+#ifdef _DECODE_CACHE
+            mmu->page_gen[0x80 + (off >> 8)]++;
+#endif
+        }
+        mmu->hdma_src += 16;
+        mmu->hdma_dst += 16;
+    }
+}
+
+/* 0xFF55: start an HBlank DMA, cancel one or run a general purpose one */
+void hdma_write(mmu_t* mmu, uint8_t val)
+{
+    uint8_t count = (val & 0x7F) + 1;
+
+    if (mmu->hdma_left && !(val & 0x80)) {
+        mmu->io[0x55] = 0x80 | (mmu->hdma_left - 1);
+        mmu->hdma_left = 0;
+        return;
+    }
+
+    if (val & 0x80) {
+        mmu->hdma_left = count;
+        mmu->io[0x55] = val & 0x7F;
+        return;
+    }
+
+    /* General purpose DMA, all at once while the CPU waits */
+    hdma_copy(mmu, count);
+    mmu->io[0x55] = 0xFF;
+
+    if (mmu->gb) {
+        mmu->gb->cpu.ins_clock.m += count * HDMA_CLOCKS;
+        mmu->gb->cpu.slice = 0;
+    }
+}
+
+uint32_t mmu_hblank(mmu_t* mmu)
+{
+    if (mmu->hdma_left == 0)
+        return 0;
+
+    hdma_copy(mmu, 1);
+    mmu->hdma_left--;
+    mmu->io[0x55] = mmu->hdma_left ? mmu->hdma_left - 1 : 0xFF;
+
+    return HDMA_CLOCKS;
+}
+
+uint8_t mmu_io_read(mmu_t* mmu, uint16_t addr)
+{
+    if (addr == 0xFF0F)
+        return mmu->iflag | 0xE0;
+    if (addr == 0xFFFF)
+        return mmu->ie;
+    if (addr >= 0xFF80)
+        return mmu->zram[addr - 0xFF80];
+    if (addr >= 0xFF00)
+        return mmu->io[addr - 0xFF00];
+    if (mmu->dma_lock)
+        return 0xFF;
+    if (addr >= 0xA000 && addr < 0xC000 && mmu->mbc.ram_on && RTC_MAPPED(mmu))
+        return rtc_read(&mmu->mbc.rtc, mmu->ram_bank - 0x08);
+
+    /* Nothing mapped */
+    return 0xFF;
+}
+
+void mmu_io_write(mmu_t* mmu, uint16_t addr, uint8_t val)
+{
+    uint8_t old;
+
+    /* A new interrupt may be pending, make the CPU stop and look */
+    if (addr == 0xFF0F || addr == 0xFFFF) {
+        if (addr == 0xFF0F)
+            mmu->iflag = val & 0x1F;
+        else
+            mmu->ie = val;
+        if (mmu->gb)
+            mmu->gb->cpu.slice = 0;
+        return;
+    }
+
+    if (addr >= 0xFF80) {
+        mmu->zram[addr - 0xFF80] = val;
+        return;
+    }
+
+    if (addr >= 0xFF00) {
+        /* Lines already due are drawn with the registers as they were */
+        if (addr >= 0xFF40 && addr <= 0xFF4B && mmu->gb)
+            ppu_sync(mmu->gb);
+
+        old = mmu->io[addr - 0xFF00];
+        mmu->io[addr - 0xFF00] = val;
+
+        switch (addr) {
+        case 0xFF40:
+            if (mmu->gb)
+                ppu_lcdc(mmu->gb, old);
+            break;
+        case 0xFF41:
+            /* The mode and coincidence bits are the LCD's */
+            mmu->io[IO_STAT] = (uint8_t)(0x80 | (val & 0x78) | (old & 0x07));
+            /* fall through */
+        case 0xFF45:
+            /* A source enabled while it is on, or LYC set to LY, raises
+               the interrupt now rather than at the next mode change */
+            if (mmu->gb && (mmu->io[IO_LCDC] & 0x80))
+                ppu_stat(mmu->gb, mmu->io[IO_STAT] & 3);
+            break;
+        case 0xFF44:
+            mmu->io[IO_LY] = old;
+            break;
+        case 0xFF46:
+            oam_dma(mmu, val);
+            break;
+        case 0xFF50:
+            /* Unmap the BIOS for good */
+            if (mmu->in_bios && val) {
+                mmu->in_bios = 0;
+                mmu_map_rom0(mmu);
+            }
+            break;
+        case 0xFF51:
+            mmu->hdma_src = (uint16_t)((val << 8) | (mmu->hdma_src & 0xFF));
+            break;
+        case 0xFF52:
+            mmu->hdma_src = (uint16_t)((mmu->hdma_src & 0xFF00) | (val & 0xF0));
+            break;
+        case 0xFF53:
+            mmu->hdma_dst = (uint16_t)(((val & 0x1F) << 8) | (mmu->hdma_dst & 0xFF));
+            break;
+        case 0xFF54:
+            mmu->hdma_dst = (uint16_t)((mmu->hdma_dst & 0x1F00) | (val & 0xF0));
+            break;
+        case 0xFF55:
+            hdma_write(mmu, val);
+            break;
+        }
+        return;
+    }
+
+    if (mmu->dma_lock)
+        return;
+
+    if (addr >= 0x8000 && addr < 0xA000) {
+        addr -= 0x8000;
+        if (mmu->vram[addr] != val) {
+            if (mmu->gb)
+                ppu_sync(mmu->gb);
+            mmu->vram[addr] = val;
+            vram_dirty(mmu, addr);
+        }
+        return;
+    }
+
+    if (addr >= 0xFE00) {
+        if (mmu->oam[addr - 0xFE00] != val) {
+            if (mmu->gb)
+                ppu_sync(mmu->gb);
+            mmu->oam[addr - 0xFE00] = val;
+            mmu->oam_dirty = 1;
+        }
+        return;
+    }
+
+    if (addr < 0x8000) {
+        mbc_write(mmu, addr, val);
+    } else if (addr >= 0xA000 && addr < 0xC000 && mmu->battery && mmu->read_map[addr >> 8]) {
+        mmu->read_map[addr >> 8][addr & 0xFF] = val;
+        battery_dirty(mmu->battery, (uint32_t)(&mmu->read_map[addr >> 8][addr & 0xFF] - mmu->eram));
+    } else if (addr >= 0xA000 && addr < 0xC000 && mmu->mbc.ram_on && RTC_MAPPED(mmu)) {
+        rtc_write(&mmu->mbc.rtc, mmu->ram_bank - 0x08, val);
+        rtc_store(mmu);
+    }
+}
+
 uint8_t read_8(mmu_t* mmu, uint16_t addr)
 {
 #ifdef _DEBUG
+    if (addr == 0xFF0F || addr == 0xFFFF)
+        return mmu_io_read(mmu, addr);
+
     return mmu->ram[addr];
 #else
-    /* TODO */
-    return 0;
+    const uint8_t* page = mmu->read_map[addr >> 8];
+
+    if (page)
+        return page[addr & 0xFF];
+
+    return mmu_io_read(mmu, addr);
 #endif
 }
 
 void mmu_reset(mmu_t* mmu)
 {
-    /* TODO */
+#ifdef _DECODE_CACHE
+    int i;
+#endif
+
+    memset(mmu->wram, 0, WRAM_SIZE);
+    memset(mmu->vram, 0, VRAM_SIZE);
+    memset(mmu->oam, 0, OAM_SIZE);
+    memset(mmu->io, 0, IO_SIZE);
+    memset(mmu->zram, 0, ZRAM_SIZE);
+    mmu->io[0x55] = 0xFF;
+
+    /* Battery RAM is the save, it stays */
+    if (mmu->eram && !mmu->battery)
+        memset(mmu->eram, 0, mmu->mbc.ram_banks * ERAM_SIZE);
+
+    /* Whatever consumers made of the old contents is stale */
+    memset(mmu->tile_dirty, 0xFF, sizeof(mmu->tile_dirty));
+    memset(mmu->map_dirty, 0xFF, sizeof(mmu->map_dirty));
+    mmu->oam_dirty = 1;
+
+    /* cpu_reset() starts where the BIOS leaves off */
+    mmu->in_bios = 0;
+
+    mmu->ie = 0;
+    mmu->iflag = 0;
+
+    mmu->dma_lock = 0;
+    mmu->hdma_src = 0;
+    mmu->hdma_dst = 0;
+    mmu->hdma_left = 0;
+
+    mbc_reset(&mmu->mbc);
+    mmu->rom_bank = 1;
+    mmu->rom_bank0 = 0;
+    mmu->ram_bank = 0;
+
+#ifdef _DECODE_CACHE
+    /* Whatever was decoded from RAM is gone */
+    for (i = 0; i < 256; i++)
+        mmu->page_gen[i]++;
+#endif
+
+#ifdef _JIT_VERIFY
+    mmu->log_len = 0;
+    mmu->logging = 0;
+#endif
+
+    mmu_map(mmu);
 }
 
+#ifdef _DECODE_CACHE
+/* Bump the write generation of addr's page, and for WRAM of its echo
+   (0xC000-0xDDFF <-> 0xE000-0xFDFF) too, as code may have been decoded
+   from either. 0xDE00-0xDFFF has no echo. */
+#define CODE_WRITTEN(mmu, addr)                             \
+    do {                                                    \
+        (mmu)->page_gen[(addr) >> 8]++;                     \
+        if (((addr) >= 0xC000 && (addr) < 0xDE00) ||        \
+            ((addr) >= 0xE000 && (addr) < 0xFE00))          \
+            (mmu)->page_gen[((addr) >> 8) ^ 0x20]++;        \
+    } while (0)
+#endif
+
+/* Guest memory is little-endian whatever the host is. Putting the bytes
+   together with shifts lets the compiler use a single (unaligned) load or
+   store where the host allows it. */
 uint16_t read_16(mmu_t* mmu, uint16_t addr)
 {
-#ifdef _BIG_ENDIAN
-    return read_8(mmu, addr + 1) + (read_8(mmu, addr) << 8);
-#else
-    return read_8(mmu, addr) + (read_8(mmu, addr + 1) << 8);
+#ifndef _DEBUG
+    const uint8_t* page = mmu->read_map[addr >> 8];
+
+    /* Both bytes in the same page of plain memory */
+    if (page && (addr & 0xFF) != 0xFF) {
+        page += addr & 0xFF;
+        return (uint16_t)(page[0] | (page[1] << 8));
+    }
 #endif
+
+    return (uint16_t)(read_8(mmu, addr) | (read_8(mmu, addr + 1) << 8));
 }
 
 void write_8(mmu_t* mmu, uint16_t addr, uint8_t val)
 {
+#ifndef _DEBUG
+    uint8_t* page;
+#endif
+
+#ifdef _JIT_VERIFY
+    if (mmu->logging)
+        mmu_log(mmu, addr, read_8(mmu, addr), val, mmu_host(mmu, addr));
+#endif
+
+#ifdef _DECODE_CACHE
+    /* Code decoded from this page is stale now */
+    CODE_WRITTEN(mmu, addr);
+#endif
+
 #ifdef _DEBUG
+    if (addr == 0xFF0F || addr == 0xFFFF) {
+        mmu_io_write(mmu, addr, val);
+        return;
+    }
+
     mmu->ram[addr] = val;
 #else
-    /* TODO */
-    return 0;
+    page = mmu->write_map[addr >> 8];
+
+    if (page) {
+        page[addr & 0xFF] = val;
+        return;
+    }
+
+    mmu_io_write(mmu, addr, val);
 #endif
 }
 
 void write_16(mmu_t* mmu, uint16_t addr, uint16_t val)
 {
-#ifdef _BIG_ENDIAN
-    write_8(mmu, addr + 1, val & 0xFF);
-    write_8(mmu, addr, (val >> 8) & 0xFF);
+#if !defined(_DEBUG) && !defined(_JIT_VERIFY)
+    uint8_t* page = mmu->write_map[addr >> 8];
+
+    if (page && (addr & 0xFF) != 0xFF) {
+#ifdef _DECODE_CACHE
+        CODE_WRITTEN(mmu, addr);
+#endif
+        page += addr & 0xFF;
+        page[0] = (uint8_t)val;
+        page[1] = (uint8_t)(val >> 8);
+        return;
+    }
+#endif
+
+    write_8(mmu, addr, (uint8_t)val);
+    write_8(mmu, addr + 1, (uint8_t)(val >> 8));
+}
+
+
+#ifdef _JIT_VERIFY
+uint8_t* mmu_host(mmu_t* mmu, uint16_t addr)
+{
+    if (addr == 0xFF0F || addr == 0xFFFF)
+        return NULL;
+
+#ifdef _DEBUG
+    return &mmu->ram[addr];
 #else
-    write_8(mmu, addr, val & 0xFF);
-    write_8(mmu, addr + 1, (val >> 8) & 0xFF);
+    /* Everything mapped past ROM is memory, writable or tracked */
+    if (addr >= 0x8000 && mmu->read_map[addr >> 8])
+        return &mmu->read_map[addr >> 8][addr & 0xFF];
+    if (addr >= 0xFF80)
+        return &mmu->zram[addr - 0xFF80];
+    if (addr >= 0xFF00)
+        return &mmu->io[addr - 0xFF00];
+
+    return NULL;
 #endif
 }
 
+void mmu_rollback(mmu_t* mmu)
+{
+    mmuwrite_t* w;
+
+    mmu->logging = 0;
+
+    while (mmu->log_len > 0) {
+        w = &mmu->log[--mmu->log_len];
+        if (w->host)
+            *w->host = w->old;
+    }
+}
+#endif
@@ -29,26 +29,124 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <stdint.h>
 #include "rom.h"
+#include "mbc.h"
+#include "battery.h"
 
+#ifdef _JIT_VERIFY
+/* Journalled writes: a block's own, plus the longest general purpose
+   HDMA, which ends the block */
+#define MMU_LOG_MAX 0x900
+
+/* Journalled write */
 typedef struct {
+    uint16_t addr;
+    uint8_t old;   /* Value before */
+    uint8_t val;   /* Value written */
+    uint8_t* host; /* Where old goes back to, NULL for registers */
+} mmuwrite_t;
+#endif
+
+/* Memory sizes */
+#define VRAM_SIZE 0x2000
+#define ERAM_SIZE 0x2000 /* Per bank */
+#define WRAM_SIZE 0x2000
+#define OAM_SIZE  0x100  /* 0xFE00-0xFEFF, only 0xA0 bytes are sprites */
+
+#define VRAM_MAPS 0x1800 /* Offset of the tile maps in VRAM, tiles come before */
+#define VRAM_TILES (VRAM_MAPS / 16)
+#define IO_SIZE   0x80
+#define ZRAM_SIZE 0x80
+
+/* DMA timing, in M clocks at normal speed */
+#define OAM_DMA_CLOCKS 640 /* 0xA0 bytes, one per machine cycle */
+#define HDMA_CLOCKS    32  /* Per 16-byte block */
+
+/* Emulator context, see agb.h */
+struct agb;
+
+typedef struct mmu {
+    /* Host memory behind each 256-byte page, NULL where accesses need
+       mmu_io_read()/mmu_io_write() */
+    uint8_t* read_map[256];
+    uint8_t* write_map[256];
+
+    void* arena;   /* Allocation holding this and the memory, see mmu_init() */
     uint8_t bios[256];
     uint8_t in_bios;
+    uint8_t* vram;
     uint8_t* eram;
     uint8_t* wram;
-    uint8_t* zram;
+    uint8_t* oam;
+    uint8_t* io;   /* 0xFF00-0xFF7F */
+    uint8_t* zram; /* 0xFF80-0xFFFE */
     rom_t* rom;
 
+    /* What changed since consumers last looked. They clear the bits they
+       have caught up with. Only writes that change a byte count. */
+    uint32_t tile_dirty[VRAM_TILES / 32]; /* One bit per 16-byte tile */
+    uint32_t map_dirty[2];                /* One bit per 32-entry row of each map */
+    uint8_t oam_dirty;
+    uint16_t rom_bank;  /* ROM bank mapped at 0x4000-0x7FFF */
+    uint16_t rom_bank0; /* ROM bank mapped at 0x0000-0x3FFF */
+    uint8_t ram_bank;   /* RAM bank (or MBC3 clock register) at 0xA000-0xBFFF */
+    mbc_t mbc;
+    battery_t* battery; /* Where eram lives for battery carts, else NULL */
+    uint8_t ie;        /* Interrupt enable, 0xFFFF */
+    uint8_t iflag;     /* Interrupt flags, 0xFF0F */
+    struct agb* gb;    /* Owner, set by cpu_reset(), for registers that
+                          reach the CPU or the scheduler */
+
+    uint8_t dma_lock;  /* OAM DMA owns the bus, only page 0xFF is mapped */
+    uint16_t hdma_src; /* Next CGB HDMA source address */
+    uint16_t hdma_dst; /* Next CGB HDMA destination, offset into VRAM */
+    uint8_t hdma_left; /* 16-byte blocks left of an HBlank DMA, 0 if idle */
+
+#ifdef _DECODE_CACHE
+    uint32_t page_gen[256]; /* Write generation of each 256-byte page */
+    uint32_t map_gen;       /* Bumped whenever a bank is switched */
+#endif
+
+#ifdef _JIT_VERIFY
+    mmuwrite_t log[MMU_LOG_MAX]; /* Write journal */
+    uint16_t log_len;
+    uint8_t logging;             /* Journal writes */
+#endif
+
 #ifdef _DEBUG
     uint8_t* ram;
 #endif
 } mmu_t;
 
-/* Initialize MMU, load a ROM */
+/* Initialize MMU, load a ROM and open its save file, NULL if either
+   fails */
 mmu_t* mmu_init(char* name);
 
-/* Clear all MMU data */
+/* Free the MMU, its memory and the ROM */
+void mmu_free(mmu_t* mmu);
+
+/* Clear all MMU data, back to the power-on banks, and mark all of VRAM
+   and OAM changed. Allocates nothing. */
 void mmu_reset(mmu_t* mmu);
 
+/* Rebuild the memory map from the banks and the BIOS overlay */
+void mmu_map(mmu_t* mmu);
+
+/* Repoint just the ROM bank, bank 0 (and BIOS) or the cartridge RAM part
+   of the map, after a bank switch */
+void mmu_map_rom(mmu_t* mmu);
+void mmu_map_rom0(mmu_t* mmu);
+void mmu_map_ram(mmu_t* mmu);
+
+/* Accesses the map can't do directly: IO, HRAM, IE, MBC registers and
+   writes that are tracked (VRAM, OAM, battery RAM) */
+uint8_t mmu_io_read(mmu_t* mmu, uint16_t addr);
+void mmu_io_write(mmu_t* mmu, uint16_t addr, uint8_t val);
+
+/* Move the next 16 bytes of a running HBlank DMA, for the LCD to call at
+   the start of each HBlank. Returns the M clocks the CPU is held for, 0
+   if no HBlank DMA is running. */
+uint32_t mmu_hblank(mmu_t* mmu);
+
 /* Read 1 byte of memory from a given address */
 uint8_t read_8(mmu_t* mmu, uint16_t addr);
 
@@ -61,5 +159,14 @@ void write_8(mmu_t* mmu, uint16_t addr, uint8_t val);
 /* Write 2 bytes of memory to a given address */
 void write_16(mmu_t* mmu, uint16_t addr, uint16_t val);
 
+#ifdef _JIT_VERIFY
+/* Host byte behind addr, NULL for registers */
+uint8_t* mmu_host(mmu_t* mmu, uint16_t addr);
+
+/* Undo the journalled writes to memory and stop journalling. Registers
+   (banks, IE, IF, the clock) are left to the caller to restore. */
+void mmu_rollback(mmu_t* mmu);
+#endif
+
 #endif
 
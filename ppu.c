@@ -0,0 +1,596 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <string.h>
+#include "agb.h"
+
+#ifdef _SIMD
+#if !defined(__SSE2__) && !defined(_M_X64)
+#error "_SIMD needs SSE2"
+#endif
+#include <emmintrin.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#define PPU_AVX2 /* AVX2 kernels are built, and used if the host has it */
+#include <immintrin.h>
+#endif
+#if defined(_DEBUG) || defined(_SIMD_TEST)
+#include <stdio.h>
+#endif
+#elif defined(_SIMD_TEST)
+#error "_SIMD_TEST needs _SIMD"
+#endif
+
+/* Decode one tile, 8 rows of two bit planes, to a color index per pixel */
+void tile_decode_c(uint8_t* dst, const uint8_t* src)
+{
+    int row, x;
+
+    for (row = 0; row < 8; row++, src += 2)
+        for (x = 7; x >= 0; x--)
+            *dst++ = (uint8_t)(((src[1] >> x) & 1) << 1 | ((src[0] >> x) & 1));
+}
+
+/* Shades of count color indices through the palette register pal */
+void pal_map_c(uint8_t* dst, const uint8_t* idx, int count, uint8_t pal)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        dst[i] = (pal >> (idx[i] * 2)) & 3;
+}
+
+/* The kernels in use, ppu_simd_init() picks the fastest that checks out */
+void (*tile_decode)(uint8_t* dst, const uint8_t* src) = tile_decode_c;
+void (*pal_map)(uint8_t* dst, const uint8_t* idx, int count, uint8_t pal) = pal_map_c;
+
+#ifdef _SIMD
+/*
+ * Vector kernels. Tile rows are decoded by spreading each plane byte over
+ * 8 lanes and testing one bit per lane; shades are picked per lane from
+ * the 4 palette entries. SSE2 is the baseline, AVX2 is used when the host
+ * has it.
+ */
+uint8_t simd_ready;
+
+void tile_decode_sse2(uint8_t* dst, const uint8_t* src)
+{
+    const __m128i bit = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128,
+        1, 2, 4, 8, 16, 32, 64, (char)128);
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i v, planes, lo, hi, lo4, hi4, l, h;
+    int i;
+
+    /* l0 h0 l1 h1 ... to l0..l7 h0..h7, then each byte 4 times */
+    v = _mm_loadu_si128((const __m128i*)src);
+    planes = _mm_packus_epi16(_mm_and_si128(v, _mm_set1_epi16(0xFF)), _mm_srli_epi16(v, 8));
+    lo = _mm_unpacklo_epi8(planes, planes);
+    hi = _mm_unpackhi_epi8(planes, planes);
+
+    for (i = 0; i < 2; i++) {
+        lo4 = i ? _mm_unpackhi_epi16(lo, lo) : _mm_unpacklo_epi16(lo, lo);
+        hi4 = i ? _mm_unpackhi_epi16(hi, hi) : _mm_unpacklo_epi16(hi, hi);
+
+        /* Two rows a vector, each plane byte 8 times */
+        l = _mm_min_epu8(_mm_and_si128(_mm_unpacklo_epi32(lo4, lo4), bit), one);
+        h = _mm_min_epu8(_mm_and_si128(_mm_unpacklo_epi32(hi4, hi4), bit), one);
+        _mm_storeu_si128((__m128i*)dst, _mm_or_si128(l, _mm_add_epi8(h, h)));
+
+        l = _mm_min_epu8(_mm_and_si128(_mm_unpackhi_epi32(lo4, lo4), bit), one);
+        h = _mm_min_epu8(_mm_and_si128(_mm_unpackhi_epi32(hi4, hi4), bit), one);
+        _mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(l, _mm_add_epi8(h, h)));
+        dst += 32;
+    }
+}
+
+void pal_map_sse2(uint8_t* dst, const uint8_t* idx, int count, uint8_t pal)
+{
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    const __m128i s0 = _mm_set1_epi8(pal & 3);
+    const __m128i s1 = _mm_set1_epi8((pal >> 2) & 3);
+    const __m128i s2 = _mm_set1_epi8((pal >> 4) & 3);
+    const __m128i s3 = _mm_set1_epi8((pal >> 6) & 3);
+    __m128i v, odd, high;
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        v = _mm_loadu_si128((const __m128i*)(idx + i));
+        odd = _mm_cmpeq_epi8(_mm_and_si128(v, one), one);
+        high = _mm_cmpeq_epi8(_mm_and_si128(v, two), two);
+
+        /* Pick 1 over 0 and 3 over 2 by bit 0, then the pair by bit 1 */
+        v = _mm_or_si128(
+            _mm_andnot_si128(high, _mm_or_si128(_mm_and_si128(odd, s1), _mm_andnot_si128(odd, s0))),
+            _mm_and_si128(high, _mm_or_si128(_mm_and_si128(odd, s3), _mm_andnot_si128(odd, s2))));
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+
+    pal_map_c(dst + i, idx + i, count - i, pal);
+}
+
+#ifdef PPU_AVX2
+__attribute__((target("avx2")))
+void tile_decode_avx2(uint8_t* dst, const uint8_t* src)
+{
+    /* Plane bytes of rows 0-3 and 4-7, each 8 times, 2 rows a lane */
+    const __m256i lo03 = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2,
+        4, 4, 4, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 6, 6, 6);
+    const __m256i lo47 = _mm256_add_epi8(lo03, _mm256_set1_epi8(8));
+    const __m256i bit = _mm256_setr_epi8((char)128, 64, 32, 16, 8, 4, 2, 1,
+        (char)128, 64, 32, 16, 8, 4, 2, 1, (char)128, 64, 32, 16, 8, 4, 2, 1,
+        (char)128, 64, 32, 16, 8, 4, 2, 1);
+    const __m256i one = _mm256_set1_epi8(1);
+    __m256i v, l, h;
+
+    v = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)src));
+
+    l = _mm256_min_epu8(_mm256_and_si256(_mm256_shuffle_epi8(v, lo03), bit), one);
+    h = _mm256_min_epu8(_mm256_and_si256(_mm256_shuffle_epi8(v, _mm256_add_epi8(lo03, one)), bit), one);
+    _mm256_storeu_si256((__m256i*)dst, _mm256_or_si256(l, _mm256_add_epi8(h, h)));
+
+    l = _mm256_min_epu8(_mm256_and_si256(_mm256_shuffle_epi8(v, lo47), bit), one);
+    h = _mm256_min_epu8(_mm256_and_si256(_mm256_shuffle_epi8(v, _mm256_add_epi8(lo47, one)), bit), one);
+    _mm256_storeu_si256((__m256i*)(dst + 32), _mm256_or_si256(l, _mm256_add_epi8(h, h)));
+}
+
+__attribute__((target("avx2")))
+void pal_map_avx2(uint8_t* dst, const uint8_t* idx, int count, uint8_t pal)
+{
+    /* The 4 shades as a lookup table, indices are below 4 */
+    const __m256i shades = _mm256_setr_epi8(pal & 3, (pal >> 2) & 3, (pal >> 4) & 3, (pal >> 6) & 3,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        pal & 3, (pal >> 2) & 3, (pal >> 4) & 3, (pal >> 6) & 3,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    int i;
+
+    for (i = 0; i + 32 <= count; i += 32)
+        _mm256_storeu_si256((__m256i*)(dst + i),
+            _mm256_shuffle_epi8(shades, _mm256_loadu_si256((const __m256i*)(idx + i))));
+
+    /* Not a call into SSE code, which would pay for the dirty upper
+       halves of the registers */
+    for (; i < count; i++)
+        dst[i] = (pal >> (idx[i] * 2)) & 3;
+}
+#endif
+
+/* Check a tile and a palette kernel against the scalar ones: every pair
+   of plane bytes, every palette. Returns the number of mismatches. */
+int simd_check(void (*decode)(uint8_t*, const uint8_t*),
+    void (*map)(uint8_t*, const uint8_t*, int, uint8_t))
+{
+    uint8_t src[16];
+    uint8_t idx[LCD_W + 7];
+    uint8_t want[LCD_W + 7], got[LCD_W + 7];
+    int i, n, err = 0;
+
+    for (i = 0; i < 0x10000; i++) {
+        src[(i & 7) * 2] = (uint8_t)(i >> 8);
+        src[(i & 7) * 2 + 1] = (uint8_t)i;
+        if ((i & 7) != 7)
+            continue;
+
+        tile_decode_c(want, src);
+        decode(got, src);
+        if (memcmp(want, got, 64))
+            err++;
+    }
+
+    for (i = 0; i < LCD_W + 7; i++)
+        idx[i] = (uint8_t)((i * 7 + (i >> 3)) & 3);
+
+    /* Lengths that leave a tail for the scalar code too */
+    for (i = 0; i < 256; i++) {
+        for (n = LCD_W; n <= LCD_W + 7; n += 7) {
+            pal_map_c(want, idx, n, (uint8_t)i);
+            map(got, idx, n, (uint8_t)i);
+            if (memcmp(want, got, n))
+                err++;
+        }
+    }
+
+    return err;
+}
+
+int ppu_simd_init(void)
+{
+    int err;
+
+    simd_ready = 1;
+
+    err = simd_check(tile_decode_sse2, pal_map_sse2);
+    if (err == 0) {
+        tile_decode = tile_decode_sse2;
+        pal_map = pal_map_sse2;
+    }
+
+#ifdef PPU_AVX2
+    if (err == 0 && __builtin_cpu_supports("avx2")) {
+        err = simd_check(tile_decode_avx2, pal_map_avx2);
+        if (err == 0) {
+            tile_decode = tile_decode_avx2;
+            pal_map = pal_map_avx2;
+        }
+    }
+#endif
+
+    /* A mismatch anywhere is a bug, trust none of the vector kernels */
+    if (err) {
+        tile_decode = tile_decode_c;
+        pal_map = pal_map_c;
+#ifdef _DEBUG
+        printf("ppu_simd_init: %d mismatches\n", err);
+#endif
+    }
+
+    return err ? -1 : 0;
+}
+
+#ifdef _SIMD_TEST
+/*
+ * Bit-exact test of every vector kernel set the host can run against the
+ * scalar kernels. Exits with 1 on a mismatch. Build with -D_SIMD
+ * -D_SIMD_TEST together with cpu.c, mmu.c, mbc.c, battery.c, rom.c,
+ * inflate.c, event.c, render.c and agb.c, linking with -lpthread.
+ */
+int main(void)
+{
+    int err, failed = 0;
+
+    err = simd_check(tile_decode_sse2, pal_map_sse2);
+    printf("sse2: %d mismatches\n", err);
+    failed |= err != 0;
+
+#ifdef PPU_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        err = simd_check(tile_decode_avx2, pal_map_avx2);
+        printf("avx2: %d mismatches\n", err);
+        failed |= err != 0;
+    } else {
+        printf("avx2: not on this host, skipped\n");
+    }
+#endif
+
+    return failed;
+}
+#endif
+#endif
+
+/* Decode the tiles the MMU marked dirty, and clear their bits */
+void ppu_tiles(ppu_t* ppu, mmu_t* mmu)
+{
+    uint32_t bits;
+    int w, t, i;
+
+    for (w = 0; w < VRAM_TILES / 32; w++) {
+        bits = mmu->tile_dirty[w];
+        if (bits == 0)
+            continue;
+        mmu->tile_dirty[w] = 0;
+
+        for (i = 0; i < 32; i++) {
+            if (!(bits & ((uint32_t)1 << i)))
+                continue;
+
+            t = w * 32 + i;
+            tile_decode(ppu->tiles[t], mmu->vram + t * 16);
+        }
+    }
+}
+
+/* Color indices of one background or window row: count pixels from
+   pixel x of the 256-pixel row y of the map at map */
+void ppu_bg(ppu_t* ppu, const mmu_t* mmu, uint8_t* out, int count,
+    uint16_t map, uint8_t x, uint8_t y)
+{
+    const uint8_t* row = mmu->vram + map + (y >> 3) * 32;
+    int signed_ids = !(mmu->io[IO_LCDC] & 0x10);
+    uint8_t n;
+    int t, len;
+
+    while (count > 0) {
+        n = row[x >> 3];
+
+        /* LCDC bit 4 picks 0x8000 unsigned or 0x9000 signed numbering */
+        t = signed_ids ? 256 + (int8_t)n : n;
+
+        /* The rest of this tile's row, up to count */
+        len = 8 - (x & 7);
+        if (len > count)
+            len = count;
+        memcpy(out, ppu->tiles[t] + (y & 7) * 8 + (x & 7), len);
+        out += len;
+        count -= len;
+        x = (uint8_t)(x + len);
+    }
+}
+
+int ppu_window(const uint8_t* io, int ly)
+{
+    int wx = io[IO_WX] - 7;
+
+    if ((io[IO_LCDC] & 0x21) != 0x21 || ly < io[IO_WY] || wx >= LCD_W)
+        return LCD_W;
+    return wx;
+}
+
+void ppu_line(ppu_t* ppu, mmu_t* mmu, int ly)
+{
+    const uint8_t* io = mmu->io;
+    const uint8_t* oam;
+    const uint8_t* px;
+    uint8_t lcdc = io[IO_LCDC];
+    uint8_t idx[LCD_W];    /* Background and window color indices */
+    uint8_t spr[LCD_W];    /* Sprite shade + 1, 0 where there is none */
+    uint8_t behind[LCD_W]; /* Sprite pixel only shows over color 0 */
+    uint8_t seen[10];
+    uint8_t* fb = ppu->fb[ly];
+    uint8_t pal, c, best;
+    int h = lcdc & 0x04 ? 16 : 8;
+    int n = 0;
+    int i, j, x, row, wx;
+
+    ppu_tiles(ppu, mmu);
+
+    if (lcdc & 0x01) {
+        ppu_bg(ppu, mmu, idx, LCD_W, lcdc & 0x08 ? 0x1C00 : 0x1800,
+            io[IO_SCX], (uint8_t)(ly + io[IO_SCY]));
+
+        /* The window covers the background from WX - 7 on */
+        wx = ppu_window(io, ly);
+        if (wx < 0)
+            ppu_bg(ppu, mmu, idx, LCD_W, lcdc & 0x40 ? 0x1C00 : 0x1800,
+                (uint8_t)-wx, ppu->window_line);
+        else if (wx < LCD_W)
+            ppu_bg(ppu, mmu, idx + wx, LCD_W - wx, lcdc & 0x40 ? 0x1C00 : 0x1800,
+                0, ppu->window_line);
+    } else {
+        memset(idx, 0, LCD_W);
+    }
+
+    pal_map(fb, idx, LCD_W, io[IO_BGP]);
+
+    if (!(lcdc & 0x02))
+        return;
+
+    /* The first 10 sprites on the line in OAM order... */
+    for (i = 0; i < 40 && n < 10; i++) {
+        row = ly - (mmu->oam[i * 4] - 16);
+        if (row >= 0 && row < h)
+            seen[n++] = (uint8_t)i;
+    }
+    if (n == 0)
+        return;
+
+    /* ...are drawn from the highest priority down, the smallest X (then
+       the first in OAM) winning where they overlap */
+    memset(spr, 0, LCD_W);
+    for (; n > 0; n--) {
+        best = 0;
+        for (i = 1; i < n; i++)
+            if (mmu->oam[seen[i] * 4 + 1] < mmu->oam[seen[best] * 4 + 1])
+                best = (uint8_t)i;
+
+        oam = mmu->oam + seen[best] * 4;
+        for (i = best; i < n - 1; i++)
+            seen[i] = seen[i + 1];
+
+        row = ly - (oam[0] - 16);
+        if (oam[3] & 0x40)
+            row = h - 1 - row;
+        px = ppu->tiles[(h == 16 ? oam[2] & 0xFE : oam[2]) + (row >> 3)] + (row & 7) * 8;
+        pal = io[oam[3] & 0x10 ? IO_OBP1 : IO_OBP0];
+
+        for (j = 0; j < 8; j++) {
+            x = oam[1] - 8 + j;
+            if (x < 0 || x >= LCD_W || spr[x])
+                continue;
+            c = px[oam[3] & 0x20 ? 7 - j : j];
+            if (c == 0)
+                continue;
+            spr[x] = (uint8_t)(((pal >> (c * 2)) & 3) + 1);
+            behind[x] = oam[3] & 0x80;
+        }
+    }
+
+    for (x = 0; x < LCD_W; x++)
+        if (spr[x] && !(behind[x] && idx[x]))
+            fb[x] = spr[x] - 1;
+}
+
+/* Set the STAT mode and coincidence bits, and raise the LCD interrupt
+   when one of its enabled sources comes on */
+void ppu_stat(agb_t* gb, uint8_t mode)
+{
+    uint8_t* io = gb->cpu.mmu->io;
+    uint8_t line;
+
+    io[IO_STAT] = (uint8_t)(0x80 | (io[IO_STAT] & 0x78) | (io[IO_LY] == io[IO_LYC] ? 0x04 : 0) | mode);
+
+    line = (io[IO_STAT] & 0x44) == 0x44 ||
+        (mode == 0 && (io[IO_STAT] & 0x08)) ||
+        (mode == 1 && (io[IO_STAT] & 0x10)) ||
+        (mode == 2 && (io[IO_STAT] & 0x20));
+
+    if (line && !gb->ppu.stat_line)
+        cpu_irq(gb, IRQ_LCD);
+    gb->ppu.stat_line = line;
+}
+
+void ppu_sync(agb_t* gb)
+{
+    ppu_t* ppu = &gb->ppu;
+    mmu_t* mmu = gb->cpu.mmu;
+    const uint8_t* io = mmu->io;
+    int due;
+
+    if (!ppu->drawing || !(io[IO_LCDC] & 0x80))
+        return;
+
+    /* Lines whose HBlank has begun */
+    if (io[IO_LY] >= LCD_H)
+        due = LCD_H;
+    else
+        due = io[IO_LY] + ((io[IO_STAT] & 3) == 0);
+
+    /* Or have the worker draw them */
+    if (ppu->pipe) {
+        if (ppu->drawn < due)
+            render_lines(ppu->pipe, mmu, ppu->drawn, due - ppu->drawn);
+        ppu->drawn = (uint8_t)due;
+        return;
+    }
+
+    for (; ppu->drawn < due; ppu->drawn++) {
+        ppu_line(ppu, mmu, ppu->drawn);
+        if (ppu_window(io, ppu->drawn) < LCD_W)
+            ppu->window_line++;
+    }
+}
+
+void ppu_draw(agb_t* gb, uint32_t when);
+void ppu_hblank(agb_t* gb, uint32_t when);
+void ppu_next(agb_t* gb, uint32_t when);
+
+/* Start of line LY */
+void ppu_scan(agb_t* gb, uint32_t when)
+{
+    uint8_t* io = gb->cpu.mmu->io;
+
+    /* A new frame, the render mode is looked at once per frame */
+    if (io[IO_LY] == 0) {
+        gb->ppu.drawing = gb->ppu.render != RENDER_OFF &&
+            gb->ppu.frames % gb->ppu.render == 0;
+        gb->ppu.drawn = 0;
+        gb->ppu.window_line = 0;
+    }
+
+    if (io[IO_LY] < LCD_H) {
+        ppu_stat(gb, 2);
+        sched_add(&gb->sched, EV_LCD, when + OAM_CLOCKS, ppu_draw);
+        return;
+    }
+
+    if (io[IO_LY] == LCD_H) {
+        ppu_sync(gb);
+        if (gb->ppu.pipe && gb->ppu.drawing)
+            render_frame_end(gb->ppu.pipe);
+        gb->ppu.frames++;
+        cpu_irq(gb, IRQ_VBLANK);
+    }
+    ppu_stat(gb, 1);
+    sched_add(&gb->sched, EV_LCD, when + LINE_CLOCKS, ppu_next);
+}
+
+/* End of a line, on to the next */
+void ppu_next(agb_t* gb, uint32_t when)
+{
+    uint8_t* io = gb->cpu.mmu->io;
+
+    if (++io[IO_LY] == LINES)
+        io[IO_LY] = 0;
+    ppu_scan(gb, when);
+}
+
+void ppu_draw(agb_t* gb, uint32_t when)
+{
+    ppu_stat(gb, 3);
+    sched_add(&gb->sched, EV_LCD, when + DRAW_CLOCKS, ppu_hblank);
+}
+
+void ppu_hblank(agb_t* gb, uint32_t when)
+{
+    mmu_t* mmu = gb->cpu.mmu;
+    uint32_t held;
+
+    /* The line is drawn later, see ppu_sync() */
+    ppu_stat(gb, 0);
+
+    /* The CPU waits while HBlank DMA moves its block */
+    held = mmu_hblank(mmu);
+    gb->cpu.sys_clock.m += held;
+    gb->cpu.sys_clock.t += held / 4;
+
+    sched_add(&gb->sched, EV_LCD, when + LINE_CLOCKS - OAM_CLOCKS - DRAW_CLOCKS, ppu_next);
+}
+
+/* Switching the LCD on or off takes effect once the instruction that
+   wrote LCDC is done, when the clock is exact in every core. Line 0
+   starts then; while off, LY stays at 0 in mode 0. */
+void ppu_on(agb_t* gb, uint32_t when)
+{
+    gb->cpu.mmu->io[IO_LY] = 0;
+    ppu_scan(gb, when);
+}
+
+void ppu_off(agb_t* gb, uint32_t when)
+{
+    (void)when;
+
+    gb->cpu.mmu->io[IO_LY] = 0;
+    ppu_stat(gb, 0);
+}
+
+void ppu_lcdc(agb_t* gb, uint8_t old)
+{
+    uint8_t lcdc = gb->cpu.mmu->io[IO_LCDC];
+
+    /* Either replaces whatever line event was pending */
+    if ((old ^ lcdc) & 0x80) {
+        sched_add(&gb->sched, EV_LCD, gb->cpu.sys_clock.m, lcdc & 0x80 ? ppu_on : ppu_off);
+        gb->cpu.slice = 0;
+    }
+}
+
+void ppu_reset(agb_t* gb)
+{
+    uint8_t* io = gb->cpu.mmu->io;
+    uint8_t render = gb->ppu.render;
+    struct render* pipe = gb->ppu.pipe;
+
+    memset(&gb->ppu, 0, sizeof(ppu_t));
+    gb->ppu.render = render;
+    gb->ppu.pipe = pipe;
+#ifdef _SIMD
+    if (!simd_ready)
+        ppu_simd_init();
+#endif
+
+    io[IO_LCDC] = 0x91;
+    io[IO_STAT] = 0x80;
+    io[IO_SCY] = 0;
+    io[IO_SCX] = 0;
+    io[IO_LY] = 0;
+    io[IO_LYC] = 0;
+    io[IO_BGP] = 0xFC;
+    io[IO_OBP0] = 0xFF;
+    io[IO_OBP1] = 0xFF;
+    io[IO_WY] = 0;
+    io[IO_WX] = 0;
+
+    /* mmu_reset() marked every tile changed, they are decoded again */
+    sched_add(&gb->sched, EV_LCD, gb->cpu.sys_clock.m, ppu_scan);
+}
@@ -0,0 +1,116 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef _PPU_H
+#define _PPU_H
+
+#include <stdint.h>
+#include "mmu.h"
+
+struct agb;
+struct render;
+
+#define LCD_W 160
+#define LCD_H 144
+
+/* Line timing, in M clocks */
+#define LINE_CLOCKS  456
+#define OAM_CLOCKS   80  /* Mode 2 */
+#define DRAW_CLOCKS  172 /* Mode 3, HBlank (mode 0) takes the rest */
+#define LINES        154 /* 144 drawn, then VBlank */
+
+/* LCD registers, offsets into mmu->io */
+#define IO_LCDC 0x40
+#define IO_STAT 0x41
+#define IO_SCY  0x42
+#define IO_SCX  0x43
+#define IO_LY   0x44
+#define IO_LYC  0x45
+#define IO_BGP  0x47
+#define IO_OBP0 0x48
+#define IO_OBP1 0x49
+#define IO_WY   0x4A
+#define IO_WX   0x4B
+
+/* Render modes, see agb_render(). Above 1, one frame in that many is
+   drawn. */
+#define RENDER_OFF  0
+#define RENDER_FULL 1
+
+/*
+ * Scanline renderer. Each line is drawn whole as of the start of its
+ * HBlank, but only once something is about to change what it would look
+ * like: a write to VRAM, OAM or the LCD registers, or VBlank. Lines the
+ * CPU leaves alone are drawn in one batch at VBlank, and fb is complete
+ * then. Tiles are kept decoded to one color index per byte, and a tile is
+ * decoded again only once the MMU marks it dirty.
+ */
+typedef struct {
+    uint8_t fb[LCD_H][LCD_W];          /* Shades 0 (white) to 3, palettes applied */
+    uint8_t tiles[VRAM_TILES][64];     /* Decoded tiles, color indices by row */
+    uint32_t frames;                   /* VBlanks so far */
+    uint8_t window_line;               /* Window rows drawn this frame */
+    uint8_t stat_line;                 /* STAT interrupt line, fires on its rising edge */
+    uint8_t render;                    /* Render mode, kept across resets */
+    uint8_t drawing;                   /* This frame goes to fb */
+    uint8_t drawn;                     /* Lines of this frame in fb */
+    struct render* pipe;               /* Worker drawing instead, see render.h */
+} ppu_t;
+
+/* Pixel kernels, scalar unless _SIMD picked vector ones */
+extern void (*tile_decode)(uint8_t* dst, const uint8_t* src);
+extern void (*pal_map)(uint8_t* dst, const uint8_t* idx, int count, uint8_t pal);
+
+#ifdef _SIMD
+/* Pick the widest vector kernels the host runs, after checking them
+   against the scalar ones bit for bit. Returns -1 on a mismatch in any
+   of them, and goes back to the scalar kernels. ppu_reset() calls this
+   the first time it runs; build with -D_SIMD_TEST for a test program. */
+int ppu_simd_init(void);
+#endif
+
+/* Back to the state the BIOS leaves the LCD in, and start it */
+void ppu_reset(struct agb* gb);
+
+/* Draw line ly from mmu's VRAM, OAM and registers into ppu->fb */
+void ppu_line(ppu_t* ppu, mmu_t* mmu, int ly);
+
+/* Where the window starts on line ly, LCD_W if it is not on that line */
+int ppu_window(const uint8_t* io, int ly);
+
+/* Draw the lines whose HBlank has begun, for the MMU to call before
+   anything they are drawn from changes */
+void ppu_sync(struct agb* gb);
+
+/* LCDC was written, old is what it held before */
+void ppu_lcdc(struct agb* gb, uint8_t old);
+
+/* Set the STAT mode and coincidence bits, and raise the LCD interrupt
+   when one of its enabled sources comes on. The MMU calls this with the
+   current mode once STAT or LYC is written. */
+void ppu_stat(struct agb* gb, uint8_t mode);
+
+#endif
@@ -0,0 +1,265 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "render.h"
+
+/* Draw a job's lines, then deliver the frame if it ends one */
+void render_job(render_t* r, renderjob_t* job)
+{
+    renderseg_t* seg;
+    rendersnap_t* snap = NULL;
+    uint32_t head, tail;
+    int i, w, ly;
+
+    for (i = 0; i < job->nseg; i++) {
+        seg = &job->seg[i];
+
+        /* Copies come in order, each one marks what changed before it */
+        if (snap != &job->snap[seg->snap]) {
+            snap = &job->snap[seg->snap];
+            for (w = 0; w < VRAM_TILES / 32; w++)
+                r->mmu.tile_dirty[w] |= snap->tile_dirty[w];
+            r->mmu.vram = snap->vram;
+        }
+        memcpy(r->io + IO_LCDC, seg->io, sizeof(seg->io));
+        r->mmu.oam = seg->oam;
+
+        if (seg->first == 0)
+            r->ppu.window_line = 0;
+
+        for (ly = seg->first; ly < seg->first + seg->count; ly++) {
+            ppu_line(&r->ppu, &r->mmu, ly);
+            if (ppu_window(r->io, ly) < LCD_W)
+                r->ppu.window_line++;
+        }
+    }
+
+    if (!job->frame_end)
+        return;
+
+    head = r->out_head;
+#ifdef __GNUC__
+    tail = __atomic_load_n(&r->out_tail, __ATOMIC_ACQUIRE);
+#else
+    pthread_mutex_lock(&r->lock);
+    tail = r->out_tail;
+    pthread_mutex_unlock(&r->lock);
+#endif
+
+    /* Nobody is watching, the new frame gives way */
+    if (head - tail == RENDER_OUT) {
+        r->dropped++;
+        return;
+    }
+
+    memcpy(r->out[head % RENDER_OUT], r->ppu.fb, sizeof(r->ppu.fb));
+#ifdef __GNUC__
+    __atomic_store_n(&r->out_head, head + 1, __ATOMIC_RELEASE);
+#else
+    pthread_mutex_lock(&r->lock);
+    r->out_head = head + 1;
+    pthread_mutex_unlock(&r->lock);
+#endif
+}
+
+void* render_main(void* arg)
+{
+    render_t* r = (render_t*)arg;
+    renderjob_t* job;
+
+    pthread_mutex_lock(&r->lock);
+
+    for (;;) {
+        while (r->queued == 0 && !r->stop)
+            pthread_cond_wait(&r->work, &r->lock);
+        if (r->stop)
+            break;
+
+        job = &r->jobs[r->draw % RENDER_JOBS];
+        pthread_mutex_unlock(&r->lock);
+        render_job(r, job);
+        pthread_mutex_lock(&r->lock);
+
+        r->draw++;
+        r->queued--;
+        pthread_cond_signal(&r->done);
+    }
+
+    pthread_mutex_unlock(&r->lock);
+
+    return NULL;
+}
+
+render_t* render_open(void)
+{
+    render_t* r = (render_t*)calloc(1, sizeof(render_t));
+
+    if (r == NULL)
+        return NULL;
+
+    /* Nothing of the worker's tile cache is decoded yet */
+    r->mmu.io = r->io;
+    memset(r->mmu.tile_dirty, 0xFF, sizeof(r->mmu.tile_dirty));
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->work, NULL);
+    pthread_cond_init(&r->done, NULL);
+
+    if (pthread_create(&r->thread, NULL, render_main, r) != 0) {
+        pthread_mutex_destroy(&r->lock);
+        pthread_cond_destroy(&r->work);
+        pthread_cond_destroy(&r->done);
+        free(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+void render_close(render_t* r)
+{
+    pthread_mutex_lock(&r->lock);
+    r->stop = 1;
+    pthread_cond_signal(&r->work);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(r->thread, NULL);
+
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->work);
+    pthread_cond_destroy(&r->done);
+    free(r);
+}
+
+/* Start filling the next job, once the worker is done with its slot */
+void render_begin(render_t* r)
+{
+    renderjob_t* job = &r->jobs[r->fill % RENDER_JOBS];
+
+    pthread_mutex_lock(&r->lock);
+    while (r->queued == RENDER_JOBS)
+        pthread_cond_wait(&r->done, &r->lock);
+    pthread_mutex_unlock(&r->lock);
+
+    job->nseg = 0;
+    job->nsnap = 0;
+    job->frame_end = 0;
+    r->open = 1;
+}
+
+/* Hand the job being filled to the worker */
+void render_submit(render_t* r, uint8_t frame_end)
+{
+    r->jobs[r->fill % RENDER_JOBS].frame_end = frame_end;
+    r->open = 0;
+
+    pthread_mutex_lock(&r->lock);
+    r->fill++;
+    r->queued++;
+    pthread_cond_signal(&r->work);
+    pthread_mutex_unlock(&r->lock);
+}
+
+void render_lines(render_t* r, mmu_t* mmu, int first, int count)
+{
+    renderjob_t* job;
+    renderseg_t* seg;
+    rendersnap_t* snap;
+    uint32_t changed = 0;
+    int w;
+
+    /* The MMU marks every VRAM change in these, the copy takes them */
+    for (w = 0; w < VRAM_TILES / 32; w++)
+        changed |= mmu->tile_dirty[w];
+    changed |= mmu->map_dirty[0] | mmu->map_dirty[1];
+
+    if (!r->open)
+        render_begin(r);
+    job = &r->jobs[r->fill % RENDER_JOBS];
+
+    if (job->nseg == RENDER_SEGS || (changed && job->nsnap == RENDER_SNAPS)) {
+        render_submit(r, 0);
+        render_begin(r);
+        job = &r->jobs[r->fill % RENDER_JOBS];
+    }
+
+    if (changed || job->nsnap == 0) {
+        snap = &job->snap[job->nsnap++];
+        memcpy(snap->vram, mmu->vram, VRAM_SIZE);
+        memcpy(snap->tile_dirty, mmu->tile_dirty, sizeof(snap->tile_dirty));
+        memset(mmu->tile_dirty, 0, sizeof(mmu->tile_dirty));
+        memset(mmu->map_dirty, 0, sizeof(mmu->map_dirty));
+    }
+
+    seg = &job->seg[job->nseg++];
+    seg->first = (uint8_t)first;
+    seg->count = (uint8_t)count;
+    seg->snap = (uint8_t)(job->nsnap - 1);
+    memcpy(seg->io, mmu->io + IO_LCDC, sizeof(seg->io));
+    memcpy(seg->oam, mmu->oam, sizeof(seg->oam));
+}
+
+void render_frame_end(render_t* r)
+{
+    if (!r->open)
+        render_begin(r);
+    render_submit(r, 1);
+}
+
+void render_split(render_t* r)
+{
+    if (r->open)
+        render_submit(r, 0);
+}
+
+const uint8_t* render_frame(render_t* r)
+{
+    uint32_t head;
+
+#ifdef __GNUC__
+    head = __atomic_load_n(&r->out_head, __ATOMIC_ACQUIRE);
+#else
+    pthread_mutex_lock(&r->lock);
+    head = r->out_head;
+    pthread_mutex_unlock(&r->lock);
+#endif
+
+    if (head == r->out_tail)
+        return NULL;
+    return r->out[r->out_tail % RENDER_OUT][0];
+}
+
+void render_release(render_t* r)
+{
+#ifdef __GNUC__
+    __atomic_store_n(&r->out_tail, r->out_tail + 1, __ATOMIC_RELEASE);
+#else
+    pthread_mutex_lock(&r->lock);
+    r->out_tail++;
+    pthread_mutex_unlock(&r->lock);
+#endif
+}
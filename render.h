@@ -0,0 +1,114 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#ifndef _RENDER_H
+#define _RENDER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "mmu.h"
+#include "ppu.h"
+
+#define RENDER_SEGS  64 /* Runs of lines per job */
+#define RENDER_SNAPS 16 /* VRAM copies per job */
+#define RENDER_JOBS  2  /* Jobs in flight, one filling while one is drawn */
+#define RENDER_OUT   3  /* Finished frames waiting to be taken */
+
+/* Lines drawn from the same LCD registers, OAM and VRAM copy */
+typedef struct {
+    uint8_t first, count;    /* Lines */
+    uint8_t snap;            /* VRAM copy in the job */
+    uint8_t io[12];          /* 0xFF40-0xFF4B */
+    uint8_t oam[0xA0];
+} renderseg_t;
+
+/* VRAM as it was from some segment on, taken only when it changed */
+typedef struct {
+    uint8_t vram[VRAM_SIZE];
+    uint32_t tile_dirty[VRAM_TILES / 32]; /* Tiles changed since the copy before */
+} rendersnap_t;
+
+typedef struct {
+    renderseg_t seg[RENDER_SEGS];
+    rendersnap_t snap[RENDER_SNAPS];
+    uint8_t nseg, nsnap;
+    uint8_t frame_end;       /* Deliver the frame after drawing this */
+} renderjob_t;
+
+/*
+ * Pipelined renderer. Instead of drawing, ppu_sync() logs each run of due
+ * lines together with what they are drawn from, and a worker thread draws
+ * them while the CPU goes on. VRAM is only copied again once it changed,
+ * so a frame drawn from one VRAM state costs one copy. Finished frames
+ * come out through a single-producer, single-consumer queue that takes no
+ * lock on either side.
+ */
+typedef struct render {
+    renderjob_t jobs[RENDER_JOBS];
+    uint32_t queued;         /* Jobs handed to the worker, not drawn yet */
+    uint32_t fill;           /* Job being filled, counts up */
+    uint32_t draw;           /* Job being drawn, counts up */
+    uint8_t open;            /* jobs[fill] has been started */
+    uint8_t stop;            /* Tell the worker to quit */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;     /* A job was queued, or stop */
+    pthread_cond_t done;     /* A job was drawn */
+
+    /* The worker's own view of the LCD */
+    ppu_t ppu;
+    mmu_t mmu;
+    uint8_t io[IO_SIZE];
+
+    uint8_t out[RENDER_OUT][LCD_H][LCD_W];
+    uint32_t out_head;       /* Frames delivered, written by the worker */
+    uint32_t out_tail;       /* Frames taken, written by the consumer */
+    uint32_t dropped;        /* Frames the queue had no room for */
+} render_t;
+
+/* Start a worker, NULL on failure */
+render_t* render_open(void);
+
+/* Stop the worker, dropping whatever it had not drawn */
+void render_close(render_t* r);
+
+/* Log lines [first, first + count) as mmu has them now */
+void render_lines(render_t* r, mmu_t* mmu, int first, int count);
+
+/* The frame is complete, hand its lines over */
+void render_frame_end(render_t* r);
+
+/* Hand the lines logged so far over without ending the frame, so the
+   next ones start a job of their own, with their own VRAM copy */
+void render_split(render_t* r);
+
+/* The oldest finished frame not taken yet, LCD_H rows of LCD_W shades,
+   NULL if there is none. It stays put until render_release(), which
+   only follows a frame that was returned. Call both from one thread. */
+const uint8_t* render_frame(render_t* r);
+void render_release(render_t* r);
+
+#endif
@@ -0,0 +1,496 @@
+/*
+
+Copyright 2013 Allie Saia <allie@fcraft.net>
+    https://github.com/astelyn
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#define _DEFAULT_SOURCE /* fstat, S_ISREG */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "inflate.h"
+#include "rom.h"
+
+#define ROM_BANK_SIZE 0x4000
+#define ROM_MIN_SIZE  0x8000 /* Two banks, what a cartridge without MBC maps */
+#define ROM_MAX_SIZE  0x800000 /* 8 MiB, the most any MBC banks */
+#define ROM_READ_SIZE 0x10000 /* Bytes read at a time when not mapping */
+
+#define GET16(p) ((uint32_t)(p)[0] | (uint32_t)(p)[1] << 8)
+#define GET32(p) (GET16(p) | GET16((p) + 2) << 16)
+
+/*
+ * Unpacked images, shared by every instance running the same ROM and
+ * freed with the last one. They are keyed by the CRC-32 and length the
+ * archive gives for its contents, so the same ROM packed any which way
+ * is unpacked once.
+ */
+struct romcache {
+    uint32_t crc;    /* CRC-32 of the image */
+    uint32_t len;    /* Bytes of the image, before padding */
+    uint8_t* prg;    /* Image padded to whole banks, NULL while unpacking */
+    uint32_t size;   /* Bytes of prg */
+    int refs;        /* Instances using it, or waiting for it */
+    uint8_t failed;  /* Didn't unpack, or the CRC didn't match */
+    struct romcache* next;
+};
+
+struct romcache* rom_cache = NULL;
+pthread_mutex_t rom_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t rom_cache_done = PTHREAD_COND_INITIALIZER;
+
+/* The ROM inside an archive */
+typedef struct {
+    const uint8_t* data; /* Compressed bytes */
+    size_t len;
+    uint8_t deflated;    /* DEFLATE, else stored */
+    uint32_t crc;        /* CRC-32 of the contents */
+    uint32_t size;       /* Bytes of the contents */
+} packed_t;
+
+/* RAM banks by header code 0x149 */
+const uint8_t ram_sizes[6] = { 0, 1, 1, 4, 16, 8 };
+
+/* Fill in rom->header from the image */
+void rom_header(rom_t* rom)
+{
+    romheader_t* h = &rom->header;
+    const uint8_t* p = rom->prg;
+    uint8_t sum = 0;
+    int i, len;
+
+    /* CGB games give the last bytes of the title to other fields */
+    h->cgb = p[0x143] & 0x80 ? p[0x143] & 0xC0 : 0;
+    len = h->cgb ? 15 : 16;
+    for (i = 0; i < len && p[0x134 + i]; i++)
+        h->title[i] = p[0x134 + i] >= 0x20 && p[0x134 + i] < 0x7F ? (char)p[0x134 + i] : '?';
+    while (i > 0 && h->title[i - 1] == ' ')
+        i--;
+    h->title[i] = '\0';
+
+    h->type = p[0x147];
+    h->rom_banks = p[0x148] <= 0x08 ? (uint16_t)(2 << p[0x148]) : 0;
+    h->ram_banks = p[0x149] < sizeof(ram_sizes) ? ram_sizes[p[0x149]] : 0;
+    h->checksum = p[0x14D];
+    h->global = (uint16_t)(p[0x14E] << 8 | p[0x14F]);
+
+    for (i = 0x134; i < 0x14D; i++)
+        sum = (uint8_t)(sum - p[i] - 1);
+    h->valid = sum == h->checksum;
+}
+
+int rom_global_ok(const rom_t* rom)
+{
+    uint32_t len = rom->size;
+    uint16_t sum = 0;
+    uint32_t i;
+
+    /* Leave out banks the image has past what the header gives */
+    if (rom->header.rom_banks && len > rom->header.rom_banks * (uint32_t)ROM_BANK_SIZE)
+        len = rom->header.rom_banks * (uint32_t)ROM_BANK_SIZE;
+
+    for (i = 0; i < len; i++)
+        sum = (uint16_t)(sum + rom->prg[i]);
+
+    return (uint16_t)(sum - rom->prg[0x14E] - rom->prg[0x14F]) == rom->header.global;
+}
+
+/* Whether p (len bytes) starts like a .gz or .zip file */
+int rom_packed(const uint8_t* p, size_t len)
+{
+    return len >= 4 && ((p[0] == 0x1F && p[1] == 0x8B) || GET32(p) == 0x04034B50);
+}
+
+/* Find the single member of a gzip file */
+int gz_open(packed_t* z, const uint8_t* p, size_t len)
+{
+    size_t at = 10;
+    uint8_t flags;
+
+    if (len < 18 || p[2] != 8)
+        return -1;
+    flags = p[3];
+
+    if (flags & 0x04)
+        at += 2 + GET16(p + at);       /* Extra field */
+    if (flags & 0x08)
+        while (at < len && p[at++]) ;  /* File name */
+    if (flags & 0x10)
+        while (at < len && p[at++]) ;  /* Comment */
+    if (flags & 0x02)
+        at += 2;                       /* Header CRC */
+    if (at > len - 8)
+        return -1;
+
+    z->data = p + at;
+    z->len = len - 8 - at;
+    z->deflated = 1;
+    z->crc = GET32(p + len - 8);
+    z->size = GET32(p + len - 4);
+
+    return 0;
+}
+
+/* Whether a zip member name ends in .gb or .gbc */
+int rom_named(const uint8_t* name, size_t len)
+{
+    size_t i = len;
+
+    while (i > 0 && name[i - 1] != '.')
+        i--;
+    if (i == 0)
+        return 0;
+
+    len -= i;
+    name += i;
+    return (len == 2 || (len == 3 && (name[2] | 0x20) == 'c')) &&
+        (name[0] | 0x20) == 'g' && (name[1] | 0x20) == 'b';
+}
+
+/* Find the ROM in a zip file: the first member named like one, else the
+   first file */
+int zip_open(packed_t* z, const uint8_t* p, size_t len)
+{
+    const uint8_t* e;
+    const uint8_t* pick = NULL;
+    const uint8_t* first = NULL;
+    size_t at, dir, n, name;
+
+    if (len < 22)
+        return -1;
+
+    /* The end of central directory record, followed by a comment of up to
+       64 KiB */
+    for (at = len - 22; GET32(p + at) != 0x06054B50; at--)
+        if (at == 0 || len - 22 - at > 0xFFFF)
+            return -1;
+
+    n = GET16(p + at + 10);
+    dir = GET32(p + at + 16);
+
+    while (n-- > 0 && pick == NULL) {
+        if (len < 46 || dir > len - 46 || GET32(p + dir) != 0x02014B50)
+            return -1;
+        e = p + dir;
+        name = GET16(e + 28);
+        if (name > len - 46 - dir)
+            return -1;
+
+        if (rom_named(e + 46, name))
+            pick = e;
+        else if (first == NULL && name > 0 && e[46 + name - 1] != '/')
+            first = e;
+
+        dir += 46 + name + GET16(e + 30) + GET16(e + 32);
+    }
+
+    if (pick == NULL)
+        pick = first;
+    if (pick == NULL || (GET16(pick + 8) & 0x01))  /* Encrypted */
+        return -1;
+    if (GET16(pick + 10) != 0 && GET16(pick + 10) != 8)
+        return -1;
+
+    at = GET32(pick + 42);
+    if (len < 30 || at > len - 30 || GET32(p + at) != 0x04034B50)
+        return -1;
+    at += 30 + GET16(p + at + 26) + GET16(p + at + 28);
+
+    z->len = GET32(pick + 20);
+    if (at > len || z->len > len - at)
+        return -1;
+
+    z->data = p + at;
+    z->deflated = GET16(pick + 10) == 8;
+    z->crc = GET32(pick + 16);
+    z->size = GET32(pick + 24);
+
+    return 0;
+}
+
+/* Unpack z into a new buffer padded with 0xFF to whole banks, NULL if it
+   doesn't come out as the archive says */
+uint8_t* rom_inflate(const packed_t* z, uint32_t* size)
+{
+    uint8_t* buf;
+
+    *size = (z->size + ROM_BANK_SIZE - 1) & ~(uint32_t)(ROM_BANK_SIZE - 1);
+    if (*size < ROM_MIN_SIZE)
+        *size = ROM_MIN_SIZE;
+
+    buf = (uint8_t*)malloc(*size);
+    if (buf == NULL)
+        return NULL;
+
+    if (z->deflated) {
+        if (inflate_raw(buf, z->size, z->data, z->len) != (long)z->size)
+            goto fail;
+    } else {
+        if (z->len != z->size)
+            goto fail;
+        memcpy(buf, z->data, z->size);
+    }
+
+    if (crc32_update(0, buf, z->size) != z->crc)
+        goto fail;
+
+    memset(buf + z->size, 0xFF, *size - z->size);
+    return buf;
+
+fail:
+    free(buf);
+    return NULL;
+}
+
+/* Let go of c, with rom_cache_lock held */
+void rom_cache_drop(struct romcache* c)
+{
+    struct romcache** p;
+
+    if (--c->refs > 0)
+        return;
+
+    for (p = &rom_cache; *p != c; p = &(*p)->next) ;
+    *p = c->next;
+
+    free(c->prg);
+    free(c);
+}
+
+/*
+ * Point rom at the image packed in the archive p (len bytes). Only the
+ * first instance asking for an image unpacks it, straight from the
+ * archive into the shared buffer; any others asking meanwhile wait for
+ * it. Returns -1 on failure.
+ */
+int rom_unpack(rom_t* rom, const uint8_t* p, size_t len)
+{
+    struct romcache* c;
+    packed_t z;
+    uint8_t* prg;
+    uint32_t size;
+    int ok;
+
+    if ((p[0] == 0x1F ? gz_open(&z, p, len) : zip_open(&z, p, len)) < 0 ||
+            z.size > ROM_MAX_SIZE)
+        return -1;
+
+    pthread_mutex_lock(&rom_cache_lock);
+
+    for (c = rom_cache; c; c = c->next)
+        if (c->crc == z.crc && c->len == z.size && !c->failed)
+            break;
+
+    if (c) {
+        c->refs++;
+        while (c->prg == NULL && !c->failed)
+            pthread_cond_wait(&rom_cache_done, &rom_cache_lock);
+    } else {
+        c = (struct romcache*)calloc(1, sizeof(struct romcache));
+        if (c == NULL) {
+            pthread_mutex_unlock(&rom_cache_lock);
+            return -1;
+        }
+        c->crc = z.crc;
+        c->len = z.size;
+        c->refs = 1;
+        c->next = rom_cache;
+        rom_cache = c;
+
+        pthread_mutex_unlock(&rom_cache_lock);
+        prg = rom_inflate(&z, &size);
+        pthread_mutex_lock(&rom_cache_lock);
+
+        c->prg = prg;
+        c->size = size;
+        c->failed = prg == NULL;
+        pthread_cond_broadcast(&rom_cache_done);
+    }
+
+    ok = !c->failed;
+    if (ok) {
+        rom->prg = c->prg;
+        rom->size = c->size;
+        rom->mapped = 0;
+        rom->cache = c;
+    } else {
+        rom_cache_drop(c);
+    }
+
+    pthread_mutex_unlock(&rom_cache_lock);
+
+    return ok ? 0 : -1;
+}
+
+/* Read the whole of fd into a buffer padded with 0xFF to whole banks,
+   for files that can't be mapped (pipes) or don't fill the banks. Sets
+   *read_len to the bytes read. Returns -1 on failure. */
+int rom_read(rom_t* rom, int fd, size_t* read_len)
+{
+    uint8_t* buf = NULL;
+    uint8_t* grown;
+    size_t cap = 0;
+    size_t len = 0;
+    size_t size;
+    ssize_t got;
+
+    for (;;) {
+        if (cap - len < ROM_READ_SIZE) {
+            cap = cap ? cap * 2 : ROM_MIN_SIZE + ROM_READ_SIZE;
+            grown = (uint8_t*)realloc(buf, cap);
+            if (grown == NULL) {
+                free(buf);
+                return -1;
+            }
+            buf = grown;
+        }
+
+        got = read(fd, buf + len, ROM_READ_SIZE);
+        if (got < 0) {
+            free(buf);
+            return -1;
+        }
+        if (got == 0)
+            break;
+        len += (size_t)got;
+    }
+
+    size = (len + ROM_BANK_SIZE - 1) & ~(size_t)(ROM_BANK_SIZE - 1);
+    if (size < ROM_MIN_SIZE)
+        size = ROM_MIN_SIZE;
+
+    /* Both sizes are whole banks, so cap >= size */
+    memset(buf + len, 0xFF, size - len);
+
+    rom->prg = buf;
+    rom->size = (uint32_t)size;
+    rom->mapped = 0;
+    *read_len = len;
+
+    return 0;
+}
+
+rom_t* rom_load(char* name)
+{
+    rom_t* rom = (rom_t*)calloc(1, sizeof(rom_t));
+    struct stat st;
+    uint8_t magic[4];
+    uint8_t* buf;
+    void* prg;
+    size_t len;
+    int fd;
+
+    if (rom == NULL)
+        return NULL;
+
+    rom->name = name;
+
+    fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        free(rom);
+        return NULL;
+    }
+
+    /* Archives are mapped for unpacking, and only for as long as that takes */
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size <= 0xFFFFFFFF &&
+            pread(fd, magic, 4, 0) == 4 && rom_packed(magic, 4)) {
+        prg = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (prg == MAP_FAILED) {
+            free(rom);
+            return NULL;
+        }
+        if (rom_unpack(rom, (uint8_t*)prg, (size_t)st.st_size) < 0) {
+            munmap(prg, (size_t)st.st_size);
+            free(rom);
+            return NULL;
+        }
+        munmap(prg, (size_t)st.st_size);
+        rom_header(rom);
+        return rom;
+    }
+
+    /*
+     * Map regular files read-only and shared: nothing is read until it is
+     * touched, and every instance running the same cartridge shares the
+     * pages of the page cache. Files that don't fill whole banks would
+     * fault past their end, so they get copied instead.
+     */
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size >= ROM_MIN_SIZE &&
+            (st.st_size & (ROM_BANK_SIZE - 1)) == 0 && st.st_size <= 0xFFFFFFFF) {
+        prg = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (prg != MAP_FAILED) {
+            close(fd);
+            rom->prg = (uint8_t*)prg;
+            rom->size = (uint32_t)st.st_size;
+            rom->mapped = 1;
+            rom_header(rom);
+            return rom;
+        }
+    }
+
+    if (rom_read(rom, fd, &len) < 0) {
+        close(fd);
+        free(rom);
+        return NULL;
+    }
+
+    close(fd);
+
+    /* An archive piped in */
+    if (rom_packed(rom->prg, len)) {
+        buf = rom->prg;
+        if (rom_unpack(rom, buf, len) < 0) {
+            free(buf);
+            free(rom);
+            return NULL;
+        }
+        free(buf);
+    }
+
+    rom_header(rom);
+
+    return rom;
+}
+
+void rom_free(rom_t* rom)
+{
+    if (rom == NULL)
+        return;
+
+    if (rom->cache) {
+        pthread_mutex_lock(&rom_cache_lock);
+        rom_cache_drop(rom->cache);
+        pthread_mutex_unlock(&rom_cache_lock);
+    } else if (rom->mapped)
+        munmap(rom->prg, rom->size);
+    else
+        free(rom->prg);
+
+    free(rom);
+}
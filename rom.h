@@ -27,13 +27,47 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef _ROM_H
 #define _ROM_H
 
+#include <stdint.h>
+
+/* CGB flag values */
+#define CGB_ENHANCED 0x80 /* Also runs on a DMG */
+#define CGB_ONLY     0xC0
+
+/* Cartridge header, 0x0100-0x014F, parsed once by rom_load() */
+typedef struct {
+    char title[17];     /* NUL-terminated, trailing spaces dropped */
+    uint8_t cgb;        /* CGB_ENHANCED, CGB_ONLY or 0, from 0x143 */
+    uint8_t type;       /* Cartridge type (MBC and extras), 0x147 */
+    uint16_t rom_banks; /* 16 KiB banks the size code at 0x148 gives,
+                           0 if it is unknown */
+    uint8_t ram_banks;  /* 8 KiB banks the size code at 0x149 gives */
+    uint8_t checksum;   /* Header checksum, 0x14D */
+    uint16_t global;    /* Global checksum, 0x14E-0x14F */
+    uint8_t valid;      /* The header checksum matches 0x134-0x14C */
+} romheader_t;
+
+/* Decompressed image shared by every instance of the same ROM */
+struct romcache;
+
 typedef struct {
     char* name;
     uint8_t* prg;
+    uint32_t size;  /* Bytes of prg, whole 16 KiB banks */
+    uint8_t mapped; /* prg is mapped from the file rather than read */
+    struct romcache* cache; /* Where prg came from if it was unpacked */
+    romheader_t header;
 } rom_t;
 
-/* Load a .gb ROM file from disk */
+/* Load a .gb ROM file from disk, or the ROM in a .gz or .zip archive,
+   returns NULL on failure */
 rom_t* rom_load(char* name);
 
+/* Whether the global checksum matches the image. It takes a pass over
+   the whole ROM, and hardware never checks it, so loading doesn't. */
+int rom_global_ok(const rom_t* rom);
+
+/* Unload a ROM */
+void rom_free(rom_t* rom);
+
 #endif
 